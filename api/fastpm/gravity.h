@@ -4,6 +4,9 @@ typedef struct {
     FastPMDealiasingType DealiasingType;
     FastPMPainterType PainterType;
     int PainterSupport;
+    int Interlacing; /* paint also on a mesh shifted by half a cell to suppress aliasing */
+    int ReadoutCanvases; /* number of force meshes read out in one pass; 0 for one, negative for all.
+                            with a mesh halo or balanced domains the meshes are read out one at a time. */
 } FastPMGravity;
 
 void
@@ -41,6 +41,9 @@ typedef enum { FASTPM_KERNEL_3_4, FASTPM_KERNEL_3_2, FASTPM_KERNEL_5_4,
                FASTPM_KERNEL_GADGET,
                FASTPM_KERNEL_EASTWOOD,
                FASTPM_KERNEL_NAIVE,
+               /* as 3_4, but the gradients are taken in real space with a 4 or 6 point
+                * central difference, such that only the potential is transformed back. */
+               FASTPM_KERNEL_3_4_FD, FASTPM_KERNEL_3_6_FD,
             } FastPMKernelType;
 typedef enum { FASTPM_DEALIASING_NONE,
                FASTPM_DEALIASING_GAUSSIAN, FASTPM_DEALIASING_AGGRESSIVE_GAUSSIAN,
@@ -51,6 +54,11 @@ void libfastpm_init();
 void libfastpm_cleanup();
 void libfastpm_set_memory_bound(size_t size, int allow_unordered);
 
+/* FFT plans made after importing the wisdom are measured instead of estimated;
+ * export after planning to keep the measurements for the next run. */
+void libfastpm_import_fft_wisdom(const char * filename, MPI_Comm comm);
+void libfastpm_export_fft_wisdom(const char * filename, MPI_Comm comm);
+
 extern const char * LIBFASTPM_VERSION;
 
 FASTPM_END_DECLS
@@ -54,6 +54,9 @@ fastpm_memory_alloc_details(FastPMMemory * m, size_t s, enum FastPMMemoryLocatio
 
 #define fastpm_memory_alloc(m, s, loc) fastpm_memory_alloc_details(m, s, loc, __FILE__, __LINE__)
 
+void *
+fastpm_memory_realloc(FastPMMemory * m, void * p, size_t s);
+
 FASTPM_END_DECLS
 
 #endif
@@ -7,6 +7,10 @@ struct FastPMPainter {
 
     void   (*paint)(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir);
     double (*readout)(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir);
+    /* optional; paint n particles in one call. NULL if not supported. */
+    void   (*paint_batch)(FastPMPainter * painter, FastPMFloat * canvas, double (*pos)[3], double * weight, int n, int diffdir);
+    /* read out n particles from ncanvas meshes in one call; value[c * n + i] is from canvas[c]. */
+    void   (*readout_batch)(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double (*pos)[3], double * value, int n, int diffdir);
     fastpm_kernelfunc kernel;
     fastpm_kernelfunc diff;
 
@@ -17,6 +21,7 @@ struct FastPMPainter {
     int left; /* offset to start the kernel, (support - 1) / 2*/
     int Npoints; /* (support) ** 3 */
     double shift;
+    double offset[3]; /* displacement added to the positions; for interlacing */
 };
 
 void fastpm_painter_init(FastPMPainter * painter, PM * pm,
@@ -32,6 +37,14 @@ fastpm_readout_local(FastPMPainter * painter, FastPMFloat * canvas,
         FastPMStore * p, size_t size,
         fastpm_posfunc get_position, enum FastPMPackFields attribute);
 
+/* reads out ncanvas meshes in one pass; canvas[c] is stored into attributes[c] */
+void
+fastpm_readout_local_multi(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+        FastPMStore * p, size_t size,
+        fastpm_posfunc get_position, enum FastPMPackFields * attributes);
+
+/* paint / read out with ghosts; or through a mesh halo if the pm was initialized with mesh_halo,
+ * in which case the particles shall be decomposed to the pm. */
 void
 fastpm_paint(FastPMPainter * painter, FastPMFloat * canvas,
         FastPMStore * p, fastpm_posfunc get_position, enum FastPMPackFields attribute);
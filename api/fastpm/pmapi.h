@@ -91,6 +91,9 @@ void pm_xiter_next(PMXIter * iter);
  * */
 void 
 pm_r2c(PM * pm, FastPMFloat * from, FastPMFloat * to);
+/* r2c without the factor 1 / Norm, for callers that fold it into another pass. */
+void 
+pm_r2c_unnormalized(PM * pm, FastPMFloat * from, FastPMFloat * to);
 void 
 pm_c2r(PM * pm, FastPMFloat * inplace);
 
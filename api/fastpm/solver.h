@@ -8,6 +8,7 @@ typedef struct VPM VPM;
 typedef struct VPMInit {
     double a_start;
     int pm_nc_factor;
+    int precision; /* of the FFTs, 32 or 64; 0 for the precision of the build. 32 only differs in a FASTPM_FFT_PRECISION=64 build. */
 } VPMInit;
 
 typedef struct FastPMDriftFactor FastPMDriftFactor;
@@ -46,18 +47,30 @@ typedef struct {
     VPMInit * vpminit;
     int USE_DX1_ONLY;
     int USE_SHIFT;
-    int SAVE_Q;
+    int SAVE_Q; /* keep q as a column; otherwise it is derived from the id */
     int COMPUTE_POTENTIAL;
 
     double nLPT;
     FastPMPainterType PAINTER_TYPE;
     int painter_support;
+    int painter_interlacing;
+    int readout_canvases; /* number of force meshes resident during the readout; 0 for one, negative for all */
+    int mesh_halo; /* exchange a mesh halo instead of particle ghosts for the force */
+    int balance_domains; /* balance the particle domains by count instead of following the pencils */
+    int fixed_point_positions; /* store the positions as 32-bit fixed point instead of double */
+    int sort_interval; /* sort the particles by cells every so many decompositions; 0 for never */
+    double sort_locality; /* sort the particles when fewer consecutive particles are in adjacent cells; 0 for never */
     FastPMForceType FORCE_TYPE;
     FastPMKernelType KERNEL_TYPE;
     FastPMDealiasingType DEALIASING_TYPE;
 
     int NprocY;  /* Use 0 for auto */
     int UseFFTW; /* Use 0 for PFFT 1 for FFTW */
+    /* time the process meshes and threads of the FFTs and use the fastest. The
+     * tuning runs once per Nmesh, and the process mesh of the first VPM is kept
+     * by all PMs, basepm included: the decomposition and the ghosts assume that
+     * the pencils of the PMs agree. */
+    int TuneFFT;
 } FastPMConfig;
 
 typedef struct {
@@ -87,12 +100,17 @@ typedef struct {
         struct {
             double min;
             double max;
+            double peak; /* the largest max so far; the allocation factor the run needed */
+            size_t np_peak; /* the largest np on a rank so far */
         } imbalance;
     } info;
 
     VPM * vpm_list;
 
     PM * basepm;
+
+    /* decompositions since the particles were last sorted by cells */
+    int nunsorted;
 } FastPMSolver;
 
 enum FastPMAction {
@@ -17,6 +17,7 @@ enum FastPMPackFields {
     PACK_DENSITY =  1L << 8,
     PACK_POTENTIAL =  1L << 9,
     PACK_TIDAL     =  1L << 10,
+    PACK_POS_FIXED =  1L << 11,
 
 
     PACK_ACC_X =  1L << 20,
@@ -54,6 +55,10 @@ struct FastPMStore {
     enum FastPMPackFields attributes; /* bit flags of allocated attributes */
 
     double (* x)[3];
+    /* positions as 32-bit fixed point fractions of BoxSize, allocated instead of x
+     * to save memory; access with get_position and fastpm_store_set_position. */
+    uint32_t (* xfixed)[3];
+    double BoxSize[3];
     float (* q)[3];
     float (* v)[3];
     float (* acc)[3];
@@ -64,6 +69,15 @@ struct FastPMStore {
     float (* potential);
     float (* tidal)[6];
     uint64_t * id;
+
+    /* the grid of fastpm_store_set_lagrangian_position; without the q column,
+     * q is derived from the id on this grid. */
+    struct {
+        ptrdiff_t Nc[3];
+        double CellSize[3];
+        double shift[3];
+    } lagrangian;
+
     size_t np;
     size_t np_upper;
     double a_x;
@@ -77,6 +91,11 @@ size_t
 fastpm_store_init_evenly(FastPMStore * p, size_t np_total, enum FastPMPackFields attributes,
     double alloc_factor, MPI_Comm comm);
 
+/* Grow the columns to hold np_upper particles; the columns may move. Raises
+ * if the memory is exhausted. */
+void
+fastpm_store_reserve(FastPMStore * p, size_t np_upper);
+
 void
 fastpm_store_destroy(FastPMStore * p);
 
@@ -89,13 +108,28 @@ fastpm_store_set_lagrangian_position(FastPMStore * p, PM * pm, double shift[3],
 void
 fastpm_store_wrap(FastPMStore * p, double BoxSize[3]);
 
+/* the rank of particle index; called concurrently from several threads. */
 typedef int (*fastpm_store_target_func)(void * pdata, ptrdiff_t index, void * data);
 
 void
 fastpm_store_decompose(FastPMStore * p, fastpm_store_target_func target_func, void * data, MPI_Comm comm);
 
+/* decompose to the ranks of pm (FastPMTargetPM); the particles already in the
+ * local region of pm are not looked up. */
+void
+fastpm_store_decompose_pm(FastPMStore * p, PM * pm, MPI_Comm comm);
+
 void fastpm_store_sort_by_id(FastPMStore * p);
 
+/* sort the particles by the Morton key of their cells in pm, for the locality of
+ * painting and reading out. */
+void
+fastpm_store_sort_by_cell(FastPMStore * p, PM * pm);
+
+/* the fraction of the consecutive particles that are in the same or adjacent cells of pm */
+double
+fastpm_store_cell_locality(FastPMStore * p, PM * pm);
+
 size_t
 fastpm_store_get_np_total(FastPMStore * p, MPI_Comm comm);
 
@@ -110,6 +144,8 @@ void
 fastpm_store_copy(FastPMStore * in, FastPMStore * out);
 
 void fastpm_store_get_position(FastPMStore * p, ptrdiff_t index, double pos[3]);
+void fastpm_store_get_position_fixed(FastPMStore * p, ptrdiff_t index, double pos[3]);
+void fastpm_store_set_position(FastPMStore * p, ptrdiff_t index, double pos[3]);
 void fastpm_store_get_lagrangian_position(FastPMStore * p, ptrdiff_t index, double pos[3]);
 
 int
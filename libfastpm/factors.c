@@ -66,24 +66,26 @@ fastpm_drift_one(FastPMDriftFactor * drift, FastPMStore * p, ptrdiff_t i, double
         da1  = drift->da1[l] * u + drift->da1[l + 1] * v;
         da2  = drift->da2[l] * u + drift->da2[l + 1] * v;
     }
+    double xi[3];
+    p->get_position(p, i, xi);
     int d;
     for(d = 0; d < 3; d ++) {
         double v;
         switch(drift->forcemode) {
             case FASTPM_FORCE_2LPT:
-                xo[d] = p->x[i][d] + p->dx1[i][d] * da1 + p->dx2[i][d] * da2;
+                xo[d] = xi[d] + p->dx1[i][d] * da1 + p->dx2[i][d] * da2;
             break;
             case FASTPM_FORCE_ZA:
-                xo[d] = p->x[i][d] + p->dx1[i][d] * da1;
+                xo[d] = xi[d] + p->dx1[i][d] * da1;
             break;
             case FASTPM_FORCE_FASTPM:
             case FASTPM_FORCE_PM:
-                xo[d] = p->x[i][d] + p->v[i][d] * dyyy;
+                xo[d] = xi[d] + p->v[i][d] * dyyy;
             break;
             case FASTPM_FORCE_COLA:
                 /* For cola, remove the lpt velocity to find the residual velocity v*/
                 v = p->v[i][d] - (p->dx1[i][d]*drift->Dv1 + p->dx2[i][d]*drift->Dv2);
-                xo[d] = p->x[i][d] + v * dyyy;
+                xo[d] = xi[d] + v * dyyy;
                 xo[d] += p->dx1[i][d] * da1 + p->dx2[i][d] * da2;
             break;
         }
@@ -274,10 +276,7 @@ fastpm_drift_store(FastPMDriftFactor * drift,
     for(i=0; i<np; i++) {
         double xo[3] = {0};
         fastpm_drift_one(drift, pi, i, xo, af);
-        int d;
-        for(d = 0; d < 3; d ++) {
-            po->x[i][d] = xo[d];
-        }
+        fastpm_store_set_position(po, i, xo);
     }
     po->a_x = af;
 }
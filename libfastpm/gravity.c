@@ -8,242 +8,365 @@
 
 #include "pmpfft.h"
 #include "pmghosts.h"
+#include "pmhalo.h"
+#include "pmdomain.h"
 
+static double
+sinc_unnormed(double x)
+{
+    if(x < 1e-5 && x > -1e-5) {
+        double x2 = x * x;
+        return 1.0 - x2 / 6. + x2  * x2 / 120.;
+    } else {
+        return sin(x) / x;
+    }
+}
+
+/* The k-space operator of a field: the dealiasing, the sharpening of the mass
+ * assignment, the Green's function and the derivatives, as one factor per mode. */
+typedef struct {
+    int potential;  /* apply - 1 / k2 */
+    int potorder;
+    int ngrad;      /* the number of derivatives i k[dir[n]] */
+    int dir[2];
+    int gradorder;  /* 0 for k, 1 for the 4 point and 2 for the 6 point central difference */
+    int ndecic;     /* the number of decic sharpenings */
+    int dealias;    /* also apply the dealiasing to from in place */
+} GravityKernel;
+
+/* Apply the kernel to from and store to to in a single sweep; from and to can be the same.
+ * With kernel->dealias from is dealiased in the same sweep, and to receives the kernel
+ * of the dealiased from.
+ *
+ * The factors that are separable along the axes (the gaussian dealiasing and the decic)
+ * are tabulated; the others are evaluated per mode. */
 static void
-apply_pot_transfer(PM * pm, FastPMFloat * from, FastPMFloat * to, int order)
+apply_gravity_kernel(FastPMGravity * gravity, PM * pm, GravityKernel * kernel, FastPMFloat * from, FastPMFloat * to)
 {
+    double k_nq = M_PI / pm->BoxSize[0] * pm->Nmesh[0];
+    double kth2 = pow(2.0 / 3 * k_nq, 2);
+    double r0 = 0;
+    int type = kernel->dealias ? gravity->DealiasingType : FASTPM_DEALIASING_NONE;
+
+    switch(type) {
+        case FASTPM_DEALIASING_GAUSSIAN:
+            /* r0 is the rms in mesh size */
+            r0 = 1.0 * pm->BoxSize[0] / pm->Nmesh[0];
+        break;
+        case FASTPM_DEALIASING_AGGRESSIVE_GAUSSIAN:
+            r0 = 4.0 * pm->BoxSize[0] / pm->Nmesh[0];
+        break;
+        case FASTPM_DEALIASING_TWO_THIRD:
+        case FASTPM_DEALIASING_GAUSSIAN36:
+        case FASTPM_DEALIASING_NONE:
+        break;
+        default:
+            fastpm_raise(-1, "wrong dealiasing kernel type");
+    }
+
+    double * gaussian[3];
+    double * table[3];
+    double * k6[3];
+    int d;
+    ptrdiff_t i;
+    for(d = 0; d < 3; d ++) {
+        gaussian[d] = malloc(sizeof(double) * pm->Nmesh[d]);
+        table[d] = malloc(sizeof(double) * pm->Nmesh[d]);
+        k6[d] = malloc(sizeof(double) * pm->Nmesh[d]);
+        for(i = 0; i < pm->Nmesh[d]; i ++) {
+            double k = pm->MeshtoK[d][i];
+            double w = k * pm->CellSize[d];
+            /* 6 point central diff */
+            k6[d][i] = 1 / pm->CellSize[d] * (45 * sin(w) - 9 * sin(2 * w) + sin(3 * w)) / 30.;
+            gaussian[d][i] = exp(- 0.5 * pow(k * r0, 2));
+            double fac = 1;
+            /* Watchout: this does divide by sinc, not sinc 2, */
+            double cic = sinc_unnormed(0.5 * k * pm->CellSize[d]);
+            int n;
+            for(n = 0; n < kernel->ndecic; n ++) {
+                fac *= 1.0 / pow(cic, 2);
+            }
+            table[d][i] = fac;
+        }
+    }
+
 #pragma omp parallel
     {
         PMKIter kiter;
+        ptrdiff_t * Nmesh = pm_nmesh(pm);
         pm_kiter_init(pm, &kiter);
         float ** kklist [3] = {kiter.kk, kiter.kk_finite, kiter.kk_finite2};
+        float ** klist[2] = {kiter.k, kiter.k_finite};
         for(;
             !pm_kiter_stop(&kiter);
             pm_kiter_next(&kiter)) {
+            ptrdiff_t ind = kiter.ind;
             int d;
-            double kk_finite = 0;
+            double dealias = 1;
+            double fac = 1;
+            double kk = 0;
             for(d = 0; d < 3; d++) {
-                kk_finite += kklist[order][d][kiter.iabs[d]];
+                dealias *= gaussian[d][kiter.iabs[d]];
+                fac *= table[d][kiter.iabs[d]];
+                kk += kiter.kk[d][kiter.iabs[d]];
             }
-            ptrdiff_t ind = kiter.ind;
-            /* - 1 / k2 */
-            if(LIKELY(kk_finite > 0)) {
-                to[ind + 0] = - from[ind + 0] * (1 / kk_finite);
-                to[ind + 1] = - from[ind + 1] * (1 / kk_finite);
+            switch(type) {
+                case FASTPM_DEALIASING_TWO_THIRD:
+                    if(kk >= kth2) dealias = 0;
+                break;
+                case FASTPM_DEALIASING_GAUSSIAN36:
+                    dealias *= exp(- 36 * pow(sqrt(kk) / k_nq, 36));
+                break;
+                default:
+                break;
+            }
+            if(kernel->dealias) {
+                from[ind + 0] *= dealias;
+                from[ind + 1] *= dealias;
+            }
+            if(kernel->potential) {
+                double kk_finite = 0;
+                for(d = 0; d < 3; d++) {
+                    kk_finite += kklist[kernel->potorder][d][kiter.iabs[d]];
+                }
+                /* - 1 / k2 */
+                if(LIKELY(kk_finite > 0)) {
+                    fac *= - (1 / kk_finite);
+                } else {
+                    fac = 0;
+                }
+            }
+            if(kernel->ngrad > 0) {
+                if(
+                    kiter.iabs[0] == (Nmesh[0] - kiter.iabs[0]) % Nmesh[0] &&
+                    kiter.iabs[1] == (Nmesh[1] - kiter.iabs[1]) % Nmesh[1] &&
+                    kiter.iabs[2] == (Nmesh[2] - kiter.iabs[2]) % Nmesh[2]
+                ) {
+                    /* We are at the nyquist and the diff operator shall be zero;
+                     * otherwise the force is not real! */
+                    fac = 0;
+                }
+                int n;
+                for(n = 0; n < kernel->ngrad; n ++) {
+                    int dir = kernel->dir[n];
+                    if(kernel->gradorder == 2) {
+                        fac *= k6[dir][kiter.iabs[dir]];
+                    } else {
+                        fac *= klist[kernel->gradorder][dir][kiter.iabs[dir]];
+                    }
+                }
+            }
+            /* i k[d] for one derivative, - k[d1] k[d2] for two. Watch out the data dependency */
+            if(kernel->ngrad == 1) {
+                FastPMFloat tmp = from[ind + 0] * fac;
+                to[ind + 0] = - from[ind + 1] * fac;
+                to[ind + 1] = tmp;
             } else {
-                to[ind + 0] = 0;
-                to[ind + 1] = 0;
+                if(kernel->ngrad == 2) fac = - fac;
+                to[ind + 0] = from[ind + 0] * fac;
+                to[ind + 1] = from[ind + 1] * fac;
             }
         }
     }
+    for(d = 2; d >= 0; d --) {
+        free(k6[d]);
+        free(table[d]);
+        free(gaussian[d]);
+    }
 }
 
+/* Combine the density painted on the mesh shifted by half a cell with the base one:
+ * delta_k = (delta_k + shifted_k * exp(i k shift)) / 2 . An alias from k + 2 k_N n picks
+ * up a sign (-1)^(n_x + n_y + n_z) from the shift, so the aliases with an odd
+ * n_x + n_y + n_z cancel; those with an even sum (e.g. n = (1, 1, 0)) remain. */
 static void
-apply_grad_transfer(PM * pm, FastPMFloat * from, FastPMFloat * to, int dir, int order)
+apply_interlacing(PM * pm, FastPMFloat * delta_k, FastPMFloat * shifted_k)
 {
-#pragma omp parallel 
-    {
-        PMKIter kiter;
-        ptrdiff_t * Nmesh = pm_nmesh(pm);
-        pm_kiter_init(pm, &kiter);
-        float ** klist[2] = {kiter.k, kiter.k_finite};
-        for(;
-            !pm_kiter_stop(&kiter);
-            pm_kiter_next(&kiter)) {
-            double k_finite;
-            k_finite = klist[order][dir][kiter.iabs[dir]];
-            ptrdiff_t ind = kiter.ind;
-            /* i k[d] */
-            /* Watch out the data dependency */
-            if(
-                kiter.iabs[0] == (Nmesh[0] - kiter.iabs[0]) % Nmesh[0] &&
-                kiter.iabs[1] == (Nmesh[1] - kiter.iabs[1]) % Nmesh[1] &&
-                kiter.iabs[2] == (Nmesh[2] - kiter.iabs[2]) % Nmesh[2]
-            ) {
-                /* We are at the nyquist and the diff operator shall be zero;
-                 * otherwise the force is not real! */
-                to[kiter.ind + 0] = 0;
-                to[kiter.ind + 1] = 0;
-            } else {
-                FastPMFloat tmp = from[ind + 0] * (k_finite);
-                to[ind + 0] = - from[ind + 1] * (k_finite);
-                to[ind + 1] = tmp;
+    double * phase[3];
+    int d;
+    ptrdiff_t i;
+    for(d = 0; d < 3; d ++) {
+        if(pm->HalfCellPhase[d] == NULL) {
+            pm->HalfCellPhase[d] = malloc(sizeof(double) * 2 * pm->Nmesh[d]);
+            for(i = 0; i < pm->Nmesh[d]; i ++) {
+                double kx = pm->MeshtoK[d][i] * 0.5 * pm->CellSize[d];
+                pm->HalfCellPhase[d][2 * i + 0] = cos(kx);
+                pm->HalfCellPhase[d][2 * i + 1] = sin(kx);
             }
         }
+        phase[d] = pm->HalfCellPhase[d];
     }
-}
-
-static void
-apply_gaussian_dealiasing(PM * pm, FastPMFloat * from, FastPMFloat * to, double N)
-{
-    /* N is rms in mesh size */
-    double r0 = N * pm->BoxSize[0] / pm->Nmesh[0];
 
 #pragma omp parallel 
     {
         PMKIter kiter;
-        int d;
-        int i;
-        double *kernel[3];
         pm_kiter_init(pm, &kiter);
-        for(d = 0; d < 3; d ++) {
-            kernel[d] = malloc(sizeof(double) * pm->Nmesh[d]);
-            for(i = 0; i < pm->Nmesh[d]; i ++) {
-                kernel[d][i] = exp(- 0.5 * pow(kiter.k[d][i] * r0, 2));
-            }
-        }
-
         for(;
             !pm_kiter_stop(&kiter);
             pm_kiter_next(&kiter)) {
+            double c = 1, s = 0;
             int d;
-            double fac = 1;
-            ptrdiff_t ind = kiter.ind;
-            for(d = 0; d < 3; d++) {
-                fac *= kernel[d][kiter.iabs[d]];
+            for(d = 0; d < 3; d ++) {
+                double c1 = phase[d][2 * kiter.iabs[d] + 0];
+                double s1 = phase[d][2 * kiter.iabs[d] + 1];
+                double tmp = c * c1 - s * s1;
+                s = c * s1 + s * c1;
+                c = tmp;
             }
-            to[ind + 0] *= fac;
-            to[ind + 1] *= fac;
+            ptrdiff_t ind = kiter.ind;
+            double re = shifted_k[ind + 0] * c - shifted_k[ind + 1] * s;
+            double im = shifted_k[ind + 0] * s + shifted_k[ind + 1] * c;
+            delta_k[ind + 0] = 0.5 * (delta_k[ind + 0] + re);
+            delta_k[ind + 1] = 0.5 * (delta_k[ind + 1] + im);
         }
     }
 }
-static double
-gaussian36(double k, double * knq)
-{
-    double x = k / *knq;
-    return exp(- 36 * pow(x, 36));
-}
 
-void
-gravity_apply_kernel_transfer(FastPMGravity * gravity,
+/* Apply the kernel of attribute to delta_k and store it to canvas; with dealias
+ * delta_k is dealiased in place in the same sweep. */
+static void
+gravity_apply_kernel(FastPMGravity * gravity,
         PM * pm,
         FastPMFloat * delta_k,
-        FastPMFloat * canvas, enum FastPMPackFields attribute)
+        FastPMFloat * canvas, enum FastPMPackFields attribute, int dealias)
 {
-    int potorder = 0;
-    int gradorder = 0;
+    GravityKernel kernel[1] = {{0}};
+    kernel->dealias = dealias;
+
     switch(gravity->KernelType) {
         case FASTPM_KERNEL_EASTWOOD:
-            potorder = 0;
-            gradorder = 0;
+            kernel->potorder = 0;
+            kernel->gradorder = 0;
             /* now sharpen for mass assignment */
-            /* L1 */
-            fastpm_apply_decic_transfer(pm, canvas, canvas);
-            /* L2 */
-            fastpm_apply_decic_transfer(pm, canvas, canvas);
+            /* L1, L2 */
+            kernel->ndecic = 2;
         break;
         case FASTPM_KERNEL_NAIVE:
-            potorder = 0;
-            gradorder = 0;
+            kernel->potorder = 0;
+            kernel->gradorder = 0;
         break;
         case FASTPM_KERNEL_GADGET:
-            potorder = 0;
-            gradorder = 1;
+            kernel->potorder = 0;
+            kernel->gradorder = 1;
         break;
         case FASTPM_KERNEL_3_4:
-            potorder = 1;
-            gradorder = 1;
+            kernel->potorder = 1;
+            kernel->gradorder = 1;
         break;
         case FASTPM_KERNEL_5_4:
-            potorder = 2;
-            gradorder = 1;
+            kernel->potorder = 2;
+            kernel->gradorder = 1;
         break;
         case FASTPM_KERNEL_3_2:
-            potorder = 1;
-            gradorder = 0;
+            kernel->potorder = 1;
+            kernel->gradorder = 0;
+        break;
+        /* the same operators as in real space; see apply_fd_gradient */
+        case FASTPM_KERNEL_3_4_FD:
+            kernel->potorder = 1;
+            kernel->gradorder = 1;
+        break;
+        case FASTPM_KERNEL_3_6_FD:
+            kernel->potorder = 1;
+            kernel->gradorder = 2;
         break;
         default:
             fastpm_raise(-1, "Wrong kernel type\n");
     }
 
-    int d1, d2;
-
+    kernel->potential = 1;
     switch(attribute) {
         case PACK_POTENTIAL:
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
             break;
         case PACK_DENSITY:
-            fastpm_apply_multiply_transfer(pm, delta_k, canvas, 1.0);
+            kernel->potential = 0;
+            kernel->ndecic = 0;
             break;
         case PACK_TIDAL_XX:
-            d1 = 0; d2 = 0;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 0; kernel->dir[1] = 0;
             break;
         case PACK_TIDAL_YY:
-            d1 = 1; d2 = 1;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 1; kernel->dir[1] = 1;
             break;
         case PACK_TIDAL_ZZ:
-            d1 = 2; d2 = 2;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 2; kernel->dir[1] = 2;
             break;
         case PACK_TIDAL_XY:
-            d1 = 0; d2 = 1;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 0; kernel->dir[1] = 1;
             break;
         case PACK_TIDAL_YZ:
-            d1 = 1; d2 = 2;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 1; kernel->dir[1] = 2;
             break;
         case PACK_TIDAL_ZX:
-            d1 = 2; d2 = 0;
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, d1, gradorder);
-            apply_grad_transfer(pm, canvas, canvas, d2, gradorder);
+            kernel->ngrad = 2; kernel->dir[0] = 2; kernel->dir[1] = 0;
             break;
         case PACK_ACC_X:
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, 0, gradorder);
+            kernel->ngrad = 1; kernel->dir[0] = 0;
             break;
         case PACK_ACC_Y:
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, 1, gradorder);
+            kernel->ngrad = 1; kernel->dir[0] = 1;
             break;
         case PACK_ACC_Z:
-            apply_pot_transfer(pm, delta_k, canvas, potorder);
-            apply_grad_transfer(pm, canvas, canvas, 2, gradorder);
+            kernel->ngrad = 1; kernel->dir[0] = 2;
             break;
         default:
             fastpm_raise(-1, "Unknown type for gravity attribute\n");
     }
+
+    apply_gravity_kernel(gravity, pm, kernel, delta_k, canvas);
+}
+
+/* delta_k is already dealiased. */
+void
+gravity_apply_kernel_transfer(FastPMGravity * gravity,
+        PM * pm,
+        FastPMFloat * delta_k,
+        FastPMFloat * canvas, enum FastPMPackFields attribute)
+{
+    gravity_apply_kernel(gravity, pm, delta_k, canvas, attribute, 0);
+}
+
+/* the number of points of the central difference of the kernels that take the gradients
+ * in real space; 0 for the others. */
+static int
+gravity_fd_points(FastPMGravity * gravity)
+{
+    switch(gravity->KernelType) {
+        case FASTPM_KERNEL_3_4_FD:
+            return 4;
+        case FASTPM_KERNEL_3_6_FD:
+            return 6;
+        default:
+            return 0;
+    }
 }
+
+/* Store the field attribute to the local mesh to, from the potential on the extended
+ * mesh of halo: the potential itself, or its gradient by the central difference of npoints
+ * points, whose transfer function is that of gradorder 1 or 2 in apply_gravity_kernel. */
 static void
-apply_dealiasing_transfer(FastPMGravity * gravity, PM * pm, FastPMFloat * from, FastPMFloat * to)
+apply_fd_gradient(PMHalo * halo, FastPMFloat * potential, FastPMFloat * to,
+    enum FastPMPackFields attribute, int npoints)
 {
-    switch(gravity->DealiasingType) {
-        case FASTPM_DEALIASING_TWO_THIRD:
-            {
-            double k_nq = M_PI / pm->BoxSize[0] * pm->Nmesh[0];
-            fastpm_apply_lowpass_transfer(pm, from, to, 2.0 / 3 * k_nq);
-            }
-        break;
-        case FASTPM_DEALIASING_GAUSSIAN:
-            apply_gaussian_dealiasing(pm, from, to, 1.0);
-        break;
-        case FASTPM_DEALIASING_AGGRESSIVE_GAUSSIAN:
-            apply_gaussian_dealiasing(pm, from, to, 4.0);
-        break;
-        case FASTPM_DEALIASING_GAUSSIAN36:
-            {
-            double k_nq = M_PI / pm->BoxSize[0] * pm->Nmesh[0];
-            fastpm_apply_any_transfer(pm, from, to, (fastpm_fkfunc) gaussian36, &k_nq);
-            }
-        break;
-        case FASTPM_DEALIASING_NONE:
-        break;
+    int dir = -1;
+
+    switch(attribute) {
+        case PACK_POTENTIAL:
+            dir = -1;
+            break;
+        case PACK_ACC_X:
+            dir = 0;
+            break;
+        case PACK_ACC_Y:
+            dir = 1;
+            break;
+        case PACK_ACC_Z:
+            dir = 2;
+            break;
         default:
-            fastpm_raise(-1, "wrong dealiasing kernel type");
+            fastpm_raise(-1, "Unknown type for a real space gradient\n");
     }
+    pm_halo_gradient(halo, potential, to, dir, npoints);
 }
 
 void
@@ -265,9 +388,32 @@ fastpm_gravity_calculate(FastPMGravity * gravity,
 
     double density_factor = pm->Norm / np;
 
-    CLOCK(ghosts);
-    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, NULL);
-    LEAVE(ghosts);
+    /* the normalization of the r2c is folded into the boost */
+    double paint_factor = density_factor / pm->Norm;
+
+    double shift[3];
+    int d;
+    for(d = 0; d < 3; d ++) {
+        shift[d] = 0.5 * pm->CellSize[d];
+    }
+
+    /* with a mesh halo the local particles are painted to the extended mesh;
+     * with balanced domains to a patch around the domain that is routed to the pencils;
+     * otherwise ghosts of the particles near the edges are painted to the local mesh. */
+    PMHalo halo[1];
+    PMGhostData * pgd = NULL;
+
+    if(pm->Domain) {
+        pm_domain_halo_init(halo, pm->Domain, painter->support);
+    } else if(pm->init.mesh_halo) {
+        pm_halo_init(halo, pm, painter->support);
+    } else {
+        CLOCK(ghosts);
+        /* particles on the shifted mesh reach one cell further */
+        pgd = pm_ghosts_create_extra(pm, p, PACK_POS, PACK_ACC | (p->potential ? PACK_POTENTIAL : 0), NULL,
+                    gravity->Interlacing ? 1 : 0);
+        LEAVE(ghosts);
+    }
 
     FastPMFloat * canvas = pm_alloc(pm);
 
@@ -281,45 +427,152 @@ fastpm_gravity_calculate(FastPMGravity * gravity,
      * we paint rho V / (B N_g^3) * B = rho / rhobar. The last B is the extra density factor.
      * */
     CLOCK(paint);
-    fastpm_paint_local(painter, canvas,
-                p, p->np + pgd->nghosts, NULL, 0);
-    fastpm_apply_multiply_transfer(pm, canvas, canvas, density_factor);
+    if(pgd) {
+        pm_ghosts_paint(pgd, painter, canvas, 0);
+    } else {
+        pm_halo_paint(halo, painter, canvas, p, NULL, 0);
+    }
+    fastpm_apply_multiply_transfer(pm, canvas, canvas, paint_factor);
     LEAVE(paint);
 
     CLOCK(r2c);
-    pm_r2c(pm, canvas, delta_k);
+    pm_r2c_unnormalized(pm, canvas, delta_k);
     LEAVE(r2c);
 
-    /* calculate the forces save them to p->acc */
-    apply_dealiasing_transfer(gravity, pm, delta_k, delta_k);
+    if(gravity->Interlacing) {
+        FastPMPainter shifted[1];
+        *shifted = *painter;
+        for(d = 0; d < 3; d ++) {
+            shifted->offset[d] = shift[d];
+        }
+        FastPMFloat * shifted_k = pm_alloc(pm);
+
+        CLOCK(paint);
+        if(pgd) {
+            pm_ghosts_paint(pgd, shifted, canvas, 0);
+        } else {
+            pm_halo_paint(halo, shifted, canvas, p, NULL, 0);
+        }
+        fastpm_apply_multiply_transfer(pm, canvas, canvas, paint_factor);
+        LEAVE(paint);
+
+        CLOCK(r2c);
+        pm_r2c_unnormalized(pm, canvas, shifted_k);
+        LEAVE(r2c);
+
+        CLOCK(interlacing);
+        apply_interlacing(pm, delta_k, shifted_k);
+        LEAVE(interlacing);
+
+        pm_free(pm, shifted_k);
+    }
+
+    /* calculate the forces save them to p->acc; delta_k is dealiased in place by the
+     * first sweep, such that the force event and the lightcones see the dealiased density. */
+    int dealias = 1;
+
+    enum FastPMPackFields ACC[4];
+    int nfields = 0;
+    ACC[nfields++] = PACK_ACC_X;
+    ACC[nfields++] = PACK_ACC_Y;
+    ACC[nfields++] = PACK_ACC_Z;
+    /* skip potential if not wanted */
+    if(p->potential != NULL)
+        ACC[nfields++] = PACK_POTENTIAL;
+
+    /* keep up to ReadoutCanvases force meshes, such that the readout weights are
+     * computed once for all of them. */
+    int nresident = gravity->ReadoutCanvases;
+    if(nresident == 0) nresident = 1;
+    if(nresident < 0 || nresident > nfields) nresident = nfields;
+
+    /* with a real space kernel only the potential is transformed back; the halo
+     * of the pencils is wide enough for the difference stencil. */
+    int fdpoints = gravity_fd_points(gravity);
+    PMHalo fdhalo[1];
+    FastPMFloat * fdpotential = NULL;
+    if(fdpoints) {
+        pm_halo_init(fdhalo, pm, fdpoints / 2);
+        fdpotential = pm_alloc(&fdhalo->pm);
 
-    int d;
-    enum FastPMPackFields ACC[] = {
-                 PACK_ACC_X, PACK_ACC_Y, PACK_ACC_Z,
-                 PACK_POTENTIAL,
-                };
-
-    for(d = 0; d < 3 + 1; d ++) {
-        /* skip potential if not wanted */
-        if(p->potential == NULL && ACC[d] == PACK_POTENTIAL) continue;
         CLOCK(transfer);
-        gravity_apply_kernel_transfer(gravity, pm, delta_k, canvas, ACC[d]);
+        gravity_apply_kernel(gravity, pm, delta_k, canvas, PACK_POTENTIAL, dealias);
+        dealias = 0;
         LEAVE(transfer);
 
         CLOCK(c2r);
         pm_c2r(pm, canvas);
         LEAVE(c2r);
 
+        CLOCK(halo);
+        pm_halo_fill(fdhalo, canvas, fdpotential);
+        LEAVE(halo);
+    }
+
+    FastPMFloat * canvases[nresident];
+    int c;
+    canvases[0] = canvas;
+    for(c = 1; c < nresident; c ++) {
+        canvases[c] = pm_alloc(pm);
+    }
+
+    /* the reduction of all fields is deferred to a single exchange */
+    enum FastPMPackFields reduction = 0;
+
+    int f;
+    for(f = 0; f < nfields; f += nresident) {
+        int n = nfields - f < nresident ? nfields - f : nresident;
+
+        for(c = 0; c < n; c ++) {
+            if(fdpoints) {
+                CLOCK(gradient);
+                apply_fd_gradient(fdhalo, fdpotential, canvases[c], ACC[f + c], fdpoints);
+                LEAVE(gradient);
+                continue;
+            }
+            CLOCK(transfer);
+            gravity_apply_kernel(gravity, pm, delta_k, canvases[c], ACC[f + c], dealias);
+            dealias = 0;
+            LEAVE(transfer);
+
+            CLOCK(c2r);
+            pm_c2r(pm, canvases[c]);
+            LEAVE(c2r);
+        }
+
         CLOCK(readout);
-        fastpm_readout_local(reader, canvas, p, p->np + pgd->nghosts, NULL, ACC[d]);
+        if(pgd) {
+            pm_ghosts_readout_multi(pgd, reader, canvases, n, &ACC[f]);
+        } else {
+            pm_halo_readout_multi(halo, reader, canvases, n, p, NULL, &ACC[f]);
+        }
         LEAVE(readout);
 
+        for(c = 0; c < n; c ++) {
+            reduction |= ACC[f + c];
+        }
+    }
+
+    if(pgd) {
         CLOCK(reduce);
-        pm_ghosts_reduce(pgd, ACC[d]);
+        pm_ghosts_reduce(pgd, reduction);
         LEAVE(reduce);
     }
 
+    for(c = nresident - 1; c >= 1; c --) {
+        pm_free(pm, canvases[c]);
+    }
+
+    if(fdpoints) {
+        pm_free(&fdhalo->pm, fdpotential);
+        pm_halo_destroy(fdhalo);
+    }
+
     pm_free(pm, canvas);
 
-    pm_ghosts_free(pgd);
+    if(pgd) {
+        pm_ghosts_free(pgd);
+    } else {
+        pm_halo_destroy(halo);
+    }
 }
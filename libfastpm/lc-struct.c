@@ -279,9 +279,7 @@ fastpm_smesh_layer_select_active(
         }
     }
 
-    if((size_t) Na * (size_t) layer->Nxy + q->np >= q->np_upper) {
-        fastpm_raise(0, "More layer points requested than np_upper (%d * %d > %td)\n", Na, layer->Nxy, q->np_upper);
-    }
+    fastpm_store_reserve(q, q->np + (size_t) Na * (size_t) layer->Nxy);
 
     size_t j = 0;
     size_t k = 0;
@@ -313,9 +311,6 @@ fastpm_smesh_layer_select_active(
                 }
                 q->aemit[q->np] = aemit;
                 q->np++;
-                if(q->np > q->np_upper) {
-                    fastpm_raise(-1, "too many particles are created, increase np_upper!");
-                }
             }
         }
     }
@@ -357,7 +352,7 @@ fastpm_smesh_compute_potential(
     fastpm_smesh_select_active(mesh, a_f, a_n, p_new_now);
 
     fastpm_store_wrap(p_new_now, pm->BoxSize);
-    fastpm_store_decompose(p_new_now, (fastpm_store_target_func) FastPMTargetPM, pm, pm_comm(pm));
+    fastpm_store_decompose_pm(p_new_now, pm, pm_comm(pm));
 
     /* create a proxy of p_last_then with the same position,
      * but new storage space for the potential variables */
@@ -366,6 +361,8 @@ fastpm_smesh_compute_potential(
                     /* skip pos, we'll use an external reference next line*/
                     FASTPM_MEMORY_HEAP
                     );
+    /* last.p may have grown beyond np_upper of the mesh */
+    fastpm_store_reserve(p_last_now, mesh->last.p->np);
     p_last_now->np = mesh->last.p->np;
     p_last_now->x = mesh->last.p->x;
     p_last_now->aemit = mesh->last.p->aemit;
@@ -387,28 +384,57 @@ fastpm_smesh_compute_potential(
                  PACK_TIDAL_XY, PACK_TIDAL_YZ, PACK_TIDAL_ZX
                 };
 
-    PMGhostData * pgd_last_now = pm_ghosts_create(pm, p_last_now, PACK_POS, NULL);
-    PMGhostData * pgd_new_now = pm_ghosts_create(pm, p_new_now, PACK_POS, NULL);
+    enum FastPMPackFields readout = PACK_DENSITY | PACK_POTENTIAL | PACK_TIDAL;
+    PMGhostData * pgd_last_now = pm_ghosts_create(pm, p_last_now, PACK_POS, readout, NULL);
+    PMGhostData * pgd_new_now = pm_ghosts_create(pm, p_new_now, PACK_POS, readout, NULL);
+
+    /* keep up to ReadoutCanvases meshes, such that the readout weights are
+     * computed once for all of them. */
+    int nfields = 8;
+    int nresident = gravity->ReadoutCanvases;
+    if(nresident == 0) nresident = 1;
+    if(nresident < 0 || nresident > nfields) nresident = nfields;
+
+    FastPMFloat * canvases[nresident];
+    int c;
+    canvases[0] = canvas;
+    for(c = 1; c < nresident; c ++) {
+        canvases[c] = pm_alloc(pm);
+    }
 
-    for(d = 0; d < 8; d ++) {
-        CLOCK(transfer);
-        gravity_apply_kernel_transfer(gravity, pm, delta_k, canvas, ACC[d]);
-        LEAVE(transfer);
+    /* the reduction of all fields is deferred to a single exchange per store */
+    enum FastPMPackFields reduction = 0;
 
-        CLOCK(c2r);
-        pm_c2r(pm, canvas);
-        LEAVE(c2r);
+    for(d = 0; d < nfields; d += nresident) {
+        int n = nfields - d < nresident ? nfields - d : nresident;
+
+        for(c = 0; c < n; c ++) {
+            CLOCK(transfer);
+            gravity_apply_kernel_transfer(gravity, pm, delta_k, canvases[c], ACC[d + c]);
+            LEAVE(transfer);
+
+            CLOCK(c2r);
+            pm_c2r(pm, canvases[c]);
+            LEAVE(c2r);
+        }
 
         CLOCK(readout);
-        fastpm_readout_local(reader, canvas, p_last_now, p_last_now->np + pgd_last_now->nghosts, NULL, ACC[d]);
-        fastpm_readout_local(reader, canvas, p_new_now, p_new_now->np + pgd_new_now->nghosts, NULL, ACC[d]);
+        pm_ghosts_readout_multi(pgd_last_now, reader, canvases, n, &ACC[d]);
+        pm_ghosts_readout_multi(pgd_new_now, reader, canvases, n, &ACC[d]);
         LEAVE(readout);
 
-        CLOCK(reduce);
-        pm_ghosts_reduce(pgd_last_now, ACC[d]);
-        pm_ghosts_reduce(pgd_new_now, ACC[d]);
-        LEAVE(reduce);
+        for(c = 0; c < n; c ++) {
+            reduction |= ACC[d + c];
+        }
+    }
+
+    CLOCK(reduce);
+    pm_ghosts_reduce(pgd_last_now, reduction);
+    pm_ghosts_reduce(pgd_new_now, reduction);
+    LEAVE(reduce);
 
+    for(c = nresident - 1; c >= 1; c --) {
+        pm_free(pm, canvases[c]);
     }
 
     pm_ghosts_free(pgd_new_now);
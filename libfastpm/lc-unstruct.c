@@ -116,9 +116,7 @@ funct(double a, void *params)
     if(p->v) {
         fastpm_drift_one(drift, p, i, xi, a);
     } else {
-        for(d = 0; d < 3; d ++) {
-            xi[d] = p->x[i][d];
-        }
+        p->get_position(p, i, xi);
     }
     for(d = 0; d < 4; d ++) {
         xi[d] += Fp->tileshift[d];
@@ -224,7 +222,8 @@ fastpm_usmesh_intersect_tile(FastPMUSMesh * mesh, double * tileshift,
         /* move the particle and store it. */
         ptrdiff_t next = pout->np;
         if(next == pout->np_upper) {
-            fastpm_raise(-1, "Too many particles in the light cone");
+            /* grow by at least an eighth, such that the store is not relocated on every particle */
+            fastpm_store_reserve(pout, pout->np_upper + pout->np_upper / 8 + 1);
         }
         double xi[4];
         double xo[4];
@@ -235,9 +234,7 @@ fastpm_usmesh_intersect_tile(FastPMUSMesh * mesh, double * tileshift,
             /* can we drift? if we are using a fixed grid there is no v. */
             fastpm_drift_one(drift, p, i, xi, a_emit);
         } else {
-            for(d = 0; d < 3; d ++) {
-                xi[d] = p->x[i][d];
-            }
+            p->get_position(p, i, xi);
         }
         for(d = 0; d < 4; d ++) {
             xi[d] += params.tileshift[d];
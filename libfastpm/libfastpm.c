@@ -32,3 +32,13 @@ FastPMMemory * _libfastpm_get_gmem()
 {
     return &GMEM;
 }
+
+void libfastpm_import_fft_wisdom(const char * filename, MPI_Comm comm)
+{
+    pm_module_import_wisdom(filename, comm);
+}
+
+void libfastpm_export_fft_wisdom(const char * filename, MPI_Comm comm)
+{
+    pm_module_export_wisdom(filename, comm);
+}
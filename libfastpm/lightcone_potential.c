@@ -337,13 +337,13 @@ fastpm_lcp_compute_potential(FastPMSolver * fastpm,
 
 /*XXX Following is almost a repeat of potential calc in fastpm_gravity_calculate, though positions are different*/
     int d;
-    int ACC[] = {
+    enum FastPMPackFields ACC[] = {
                  PACK_POTENTIAL,
                  PACK_TIDAL_XX, PACK_TIDAL_YY, PACK_TIDAL_ZZ,
                  PACK_TIDAL_XY, PACK_TIDAL_YZ, PACK_TIDAL_ZX
                 };
 
-    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, NULL);
+    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, PACK_POTENTIAL | PACK_TIDAL, NULL);
 
     for(d = 0; d < 7; d ++) {
         CLOCK(transfer);
@@ -355,7 +355,7 @@ fastpm_lcp_compute_potential(FastPMSolver * fastpm,
         LEAVE(c2r);
 
         CLOCK(readout);
-        fastpm_readout_local(reader, canvas, p, p->np + pgd->nghosts, NULL, ACC[d]);
+        pm_ghosts_readout_multi(pgd, reader, &canvas, 1, &ACC[d]);
         LEAVE(readout);
 
         CLOCK(reduce);
@@ -414,9 +414,7 @@ _fastpm_lcp_intersect_one(FastPMLightConeP * lcp,
 
     xi[3] = 1;
 
-    for(d = 0; d < 3; d ++) {
-            xi[d] = params->p->x[i][d];
-    }
+    params->p->get_position(params->p, i, xi);
 
     for(d = 0; d < 4; d ++) {
         xi[d] += params->tileshift[d];
@@ -555,9 +553,7 @@ fastpm_lcp_intersect_tile_grid(FastPMLightConeP * lcp, int tile,
 
         xi[3] = 1;
 
-            for(d = 0; d < 3; d ++) {
-                xi[d] = p->x[i][d];
-            }
+            p->get_position(p, i, xi);
 
         for(d = 0; d < 4; d ++) {
             xi[d] += params.tileshift[d];
@@ -10,6 +10,7 @@
 struct MemoryBlock {
     void * p;
     size_t size;
+    int hole; /* freed out of order in a bounded arena; reused or reclaimed later */
     MemoryBlock * prev; /* pointer to previous block */
     char tag[128]; /* tag */
 };
@@ -48,7 +49,7 @@ fastpm_memory_init(FastPMMemory * m, size_t total_bytes, int allow_unordered)
 
     }
 
-    m->allow_unordered = 0;
+    m->allow_unordered = allow_unordered;
     m->free_bytes = total_bytes;
     m->total_bytes = total_bytes;
     m->used_bytes = 0;
@@ -87,43 +88,78 @@ fastpm_memory_destroy(FastPMMemory * m)
     }
 }
 
+/* the first hole on the list that can hold s bytes */
+static MemoryBlock *
+_find_hole(MemoryBlock * start, size_t s)
+{
+    MemoryBlock * entry;
+    for(entry = start; entry != &head; entry = entry->prev) {
+        if(entry->hole && entry->size >= s) return entry;
+    }
+    return NULL;
+}
+
+static void
+_unlink(MemoryBlock ** start, MemoryBlock * e)
+{
+    MemoryBlock ** link;
+    for(link = start; *link != e; link = &(*link)->prev) continue;
+    *link = e->prev;
+}
+
+/* Allocate s (aligned) bytes; NULL if the memory is exhausted. In a bounded
+ * arena a hole on the same side is reused first. */
 static void *
 fastpm_memory_alloc0(FastPMMemory * m, size_t s, enum FastPMMemoryLocation loc)
 {
-    s = _align(s, m->alignment);
-    if(m->free_bytes <= s) {
-        abort();
+    MemoryBlock ** start = (loc == FASTPM_MEMORY_HEAP) ? &m->heap : &m->stack;
+    MemoryBlock * hole = m->base ? _find_hole(*start, s) : NULL;
+
+    if(hole == NULL && m->free_bytes <= s) {
+        return NULL;
+    }
+
+    MemoryBlock * entry = malloc(sizeof(head));
+    entry->p = NULL;
+    entry->size = s;
+    entry->hole = 0;
+
+    if(hole) {
+        entry->p = hole->p;
+        hole->p = (char*) hole->p + s;
+        hole->size -= s;
+        if(hole->size == 0) {
+            _unlink(start, hole);
+            free(hole);
+        }
+    } else {
+        m->free_bytes -= s;
+        switch(loc) {
+            case FASTPM_MEMORY_HEAP:
+                if(m->base) {
+                    entry->p = m->base;
+                    m->base += s;
+                } else {
+                    entry->p = malloc(s);
+                }
+            break;
+            case FASTPM_MEMORY_STACK:
+                if(m->top) {
+                    entry->p = m->top - s;
+                    m->top -= s;
+                } else {
+                    entry->p = malloc(s);
+                }
+            break;
+        }
     }
+    entry->prev = *start;
+    *start = entry;
+
     m->used_bytes += s;
-    m->free_bytes -= s;
     if(m->used_bytes > m->peak_bytes) {
         m->peak_bytes = m->used_bytes;
     }
-    MemoryBlock * entry = malloc(sizeof(head));
-    switch(loc) {
-        case FASTPM_MEMORY_HEAP:
-            if(m->base) {
-                entry->p = m->base;
-                m->base += s;
-            } else {
-                entry->p = malloc(s);
-            }
-            entry->size = s;
-            entry->prev = m->heap;
-            m->heap = entry;
-        break;
-        case FASTPM_MEMORY_STACK:
-            if(m->top) {
-                entry->p = m->top - s;
-                m->top -= s;
-            } else {
-                entry->p = malloc(s);
-            }
-            entry->size = s;
-            entry->prev = m->stack;
-            m->stack = entry;
-        break;
-    }
     return entry->p;
 }
 
@@ -133,71 +169,163 @@ fastpm_memory_alloc_details(FastPMMemory * m, size_t s, enum FastPMMemoryLocatio
     char buf[80];
     
     sprintf(buf, "%40s:%d", file, line);
-    void * r = fastpm_memory_alloc0(m, s, loc);
+    void * r = fastpm_memory_alloc0(m, _align(s, m->alignment), loc);
+    if(r == NULL) {
+        abort();
+    }
     fastpm_memory_tag(m, r, buf);
     return r;
 }
 
 
-MemoryBlock * _delist(MemoryBlock ** start, void * p, int * isfirst)
+static MemoryBlock *
+_find(MemoryBlock * start, void * p, int * isfirst)
 {
     MemoryBlock * entry = NULL;
-    MemoryBlock * last= NULL;
 
-    for(entry=*start;
-        entry != &head; last=entry, entry=entry->prev) {
-        if(entry->p == p) {
+    for(entry=start;
+        entry != &head; entry=entry->prev) {
+        if(!entry->hole && entry->p == p) {
             break;
         }
     }
-    *isfirst = entry == *start;
+    *isfirst = entry == start;
     if(entry == &head) return NULL;
+    return entry;
+}
+
+/* Turn the block e of a bounded arena into a hole. The hole merges with the
+ * holes next to it, and goes back to the free space if it borders the free
+ * space (the top of the heap or the bottom of the stack). */
+static void
+_make_hole(FastPMMemory * m, MemoryBlock ** start, MemoryBlock * e)
+{
+    e->hole = 1;
+    strcpy(e->tag, "hole");
 
-    if(last) {
-        last->prev = entry->prev;
+    MemoryBlock * entry;
+    for(entry = *start; entry != &head; ) {
+        MemoryBlock * prev = entry->prev;
+        if(entry != e && entry->hole) {
+            if((char*) entry->p + entry->size == e->p) {
+                e->p = entry->p;
+                e->size += entry->size;
+                _unlink(start, entry);
+                free(entry);
+            } else
+            if((char*) e->p + e->size == entry->p) {
+                e->size += entry->size;
+                _unlink(start, entry);
+                free(entry);
+            }
+        }
+        entry = prev;
+    }
+
+    if(start == &m->heap && (char*) e->p + e->size == m->base) {
+        m->base = e->p;
+    } else
+    if(start == &m->stack && (char*) e->p == m->top) {
+        m->top += e->size;
     } else {
-        *start = entry->prev;
+        return;
     }
-    return entry;
+    m->free_bytes += e->size;
+    _unlink(start, e);
+    free(e);
 }
 
-
 void
 fastpm_memory_free(FastPMMemory * m, void * p)
 {
+    MemoryBlock ** start = &m->stack;
     MemoryBlock * entry;
     int isfirst = 0;
-    entry = _delist(&m->stack, p, &isfirst);
-    if(entry) {
-        if(!m->allow_unordered && !isfirst) {
-            abort();
-        }
-        if(m->top) {
-            m->top += entry->size;
-        } else {
-            free(entry->p);
-        }
-        goto exit;
+    entry = _find(*start, p, &isfirst);
+    if(entry == NULL) {
+        start = &m->heap;
+        entry = _find(*start, p, &isfirst);
     }
-
-    entry = _delist(&m->heap, p, &isfirst);
-    if(entry) {
-        if(!m->allow_unordered && !isfirst) {
-            abort();
-        }
-        if(m->base) {
-            m->base -= entry->size;
-        } else {
-            free(entry->p);
-        }
-        goto exit;
+    if(entry == NULL) {
+        abort();
+    }
+    if(!m->allow_unordered && !isfirst) {
+        abort();
     }
 
-exit:
     m->used_bytes -= entry->size;
-    m->free_bytes += entry->size;
 
-    free(entry);
+    if(m->base) {
+        /* a block freed out of order stays as a hole till it is reused or reclaimed */
+        _make_hole(m, start, entry);
+    } else {
+        m->free_bytes += entry->size;
+        free(entry->p);
+        _unlink(start, entry);
+        free(entry);
+    }
+}
 
-    return;
+/* Resize the block p to s bytes, keeping its place in the order of frees.
+ * The block may move. With a bound on the memory, the last block of the heap
+ * is resized in place; other blocks grow by moving to a new block on the same
+ * side, and the old block becomes a hole (this needs allow_unordered).
+ * Returns NULL if the block cannot be resized, and p is left untouched then. */
+void *
+fastpm_memory_realloc(FastPMMemory * m, void * p, size_t s)
+{
+    MemoryBlock ** start = &m->heap;
+    MemoryBlock * entry;
+    int isfirst;
+    entry = _find(*start, p, &isfirst);
+    if(entry == NULL) {
+        start = &m->stack;
+        entry = _find(*start, p, &isfirst);
+    }
+    if(entry == NULL) abort();
+
+    s = _align(s, m->alignment);
+
+    if(m->base && !(start == &m->heap && (char*) entry->p + entry->size == m->base)) {
+        /* a shrinking block keeps its size */
+        if(s <= entry->size) return entry->p;
+        if(!m->allow_unordered) return NULL;
+
+        void * q = fastpm_memory_alloc0(m, s, start == &m->heap ? FASTPM_MEMORY_HEAP : FASTPM_MEMORY_STACK);
+        if(q == NULL) return NULL;
+        memcpy(q, entry->p, entry->size);
+
+        /* the new block is the first on the list; swap it with entry to keep the order and the tag. */
+        MemoryBlock * fresh = *start;
+        fresh->p = entry->p;
+        fresh->size = entry->size;
+        entry->p = q;
+        entry->size = s;
+        m->used_bytes -= fresh->size;
+        _make_hole(m, start, fresh);
+        return entry->p;
+    }
+
+    if(s > entry->size && m->free_bytes <= s - entry->size) {
+        return NULL;
+    }
+
+    if(m->base == NULL) {
+        void * q = realloc(entry->p, s);
+        if(q == NULL) return NULL;
+        entry->p = q;
+    } else {
+        m->base += s;
+        m->base -= entry->size;
+    }
+
+    m->used_bytes += s;
+    m->used_bytes -= entry->size;
+    m->free_bytes += entry->size;
+    m->free_bytes -= s;
+    if(m->used_bytes > m->peak_bytes) {
+        m->peak_bytes = m->used_bytes;
+    }
+    entry->size = s;
+    return entry->p;
 }
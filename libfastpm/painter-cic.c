@@ -5,187 +5,219 @@
 #include "pmpfft.h"
 /* paint and read out */
 
+/* number of particles of which the weights are computed in one vectorized sweep */
+#define CIC_BATCH 16
+
 static double
 cic_readout_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir);
 
 static void
 cic_paint_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir);
 
+static void
+cic_paint_batch(FastPMPainter * painter, FastPMFloat * canvas, double (*pos)[3], double * weight, int n, int diffdir);
+
+static void
+cic_readout_batch(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double (*pos)[3], double * value, int n, int diffdir);
+
 void
 fastpm_painter_init_cic(FastPMPainter * painter) {
     painter->readout = cic_readout_tuned;
     painter->paint = cic_paint_tuned;
+    painter->readout_batch = cic_readout_batch;
+    painter->paint_batch = cic_paint_batch;
 }
 
-
+/* not atomic; fastpm_paint_local never paints overlapping particles concurrently. */
 static inline double WRtPlus(FastPMFloat * const d, 
         const int i, const int j, const int k, const double f, PM * pm)
 {
-#pragma omp atomic
     d[k * pm->IRegion.strides[2] + j * pm->IRegion.strides[1] + i * pm->IRegion.strides[0]] += f;
     return f;
 }
-static inline double REd(FastPMFloat const * const d, const int i, const int j, const int k, const double w, PM * pm)
-{
-    return d[k * pm->IRegion.strides[2] + j * pm->IRegion.strides[1] + i * pm->IRegion.strides[0]] * w;
-}
 
+/* Computes the cells and the weights of n <= CIC_BATCH particles.
+ *
+ * The loops have no branches, such that they are vectorized; the
+ * periodic wrap-up is done with a floor division instead of a while loop.
+ * IJK and IJK1 are relative to the local region and may be out of range.
+ * */
+FASTPM_TARGET_CLONES
 static void
-cic_paint_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir)
+cic_weights(PM * pm, double (*pos)[3], int n,
+        int IJK[3][CIC_BATCH], int IJK1[3][CIC_BATCH],
+        double D[3][CIC_BATCH], double T[3][CIC_BATCH])
 {
-    PM * pm = painter->pm;
     int d;
-
-    double XYZ[3];
-    int IJK[3];
-    int IJK1[3];
-    double D[3];
-    double T[3];
-
-    for(d = 0; d < 3; d ++) {
-        XYZ[d] = pos[d]*pm->InvCellSize[d];
-        // without floor, -1 < X < 0 is mapped to I=0
-        IJK[d] = (int) floor(XYZ[d]);
-        IJK1[d] = IJK[d] + 1;
-    };
-
     for(d = 0; d < 3; d ++) {
-        D[d] = XYZ[d] - IJK[d];
-        T[d] = 1. - D[d];
-    }
-
-    if(diffdir >= 0) {
-        D[diffdir] = pm->InvCellSize[diffdir];
-        T[diffdir] = -pm->InvCellSize[diffdir];
-    }
-
-
-    // Do periodic wrapup in all directions. 
-    // Buffer particles are copied from adjacent nodes
-    for(d = 0; d < 3; d ++) {
-        while(UNLIKELY(IJK[d] < 0)) IJK[d] += pm->Nmesh[d];
-        while(UNLIKELY(IJK[d] >= pm->Nmesh[d])) IJK[d] -= pm->Nmesh[d];
-        while(UNLIKELY(IJK1[d] < 0)) IJK1[d] += pm->Nmesh[d];
-        while(UNLIKELY(IJK1[d] >= pm->Nmesh[d])) IJK1[d] -= pm->Nmesh[d];
-    }
-
-    /* start[2] == 0 */
-    for(d = 0; d < 2; d ++) {
-        IJK[d] -= pm->IRegion.start[d];
-        IJK1[d] -= pm->IRegion.start[d];
+        const double InvCellSize = pm->InvCellSize[d];
+        const double Nmesh = pm->Nmesh[d];
+        /* start[2] == 0 */
+        const int start = (d < 2)?pm->IRegion.start[d]:0;
+        const double * x = &pos[0][d];
+        int i;
+        for(i = 0; i < n; i ++) {
+            double XYZ = x[3 * i] * InvCellSize;
+            double I = floor(XYZ);
+            D[d][i] = XYZ - I;
+            T[d][i] = 1. - D[d][i];
+            // Do periodic wrapup in all directions. 
+            // Buffer particles are copied from adjacent nodes
+            I -= Nmesh * floor(I / Nmesh);
+            double I1 = I + 1;
+            I1 = (I1 >= Nmesh)? I1 - Nmesh : I1;
+            // Relative to the region, which may wrap around the box with a halo.
+            double J = I - start;
+            double J1 = I1 - start;
+            J += (J < 0) ? Nmesh : 0;
+            J -= (J >= Nmesh) ? Nmesh : 0;
+            J1 += (J1 < 0) ? Nmesh : 0;
+            J1 -= (J1 >= Nmesh) ? Nmesh : 0;
+            IJK[d][i] = (int) J;
+            IJK1[d][i] = (int) J1;
+        }
     }
+}
 
-    D[1] *= weight;
-    T[1] *= weight;
-
-    if(LIKELY(0 <= IJK[0] && IJK[0] < pm->IRegion.size[0])) {
-        if(LIKELY(0 <= IJK[1] && IJK[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK[0], IJK[1],  IJK[2],  T[2]*T[0]*T[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK[0], IJK[1],  IJK1[2], D[2]*T[0]*T[1], pm);
-        }
-        if(LIKELY(0 <= IJK1[1] && IJK1[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK[0], IJK1[1], IJK[2],  T[2]*T[0]*D[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK[0], IJK1[1], IJK1[2], D[2]*T[0]*D[1], pm);
+static void
+cic_paint_batch(FastPMPainter * painter, FastPMFloat * canvas, double (*pos)[3], double * weight, int n, int diffdir)
+{
+    PM * pm = painter->pm;
+    int IJK[3][CIC_BATCH];
+    int IJK1[3][CIC_BATCH];
+    double D[3][CIC_BATCH];
+    double T[3][CIC_BATCH];
+    const unsigned int size[3] = {pm->IRegion.size[0], pm->IRegion.size[1], pm->IRegion.size[2]};
+
+    for(; n > 0; n -= CIC_BATCH, pos += CIC_BATCH, weight += CIC_BATCH) {
+        int nb = n < CIC_BATCH ? n : CIC_BATCH;
+        int i;
+
+        cic_weights(pm, pos, nb, IJK, IJK1, D, T);
+
+        if(diffdir >= 0) {
+            for(i = 0; i < nb; i ++) {
+                D[diffdir][i] = pm->InvCellSize[diffdir];
+                T[diffdir][i] = -pm->InvCellSize[diffdir];
+            }
         }
-    }
 
-    if(LIKELY(0 <= IJK1[0] && IJK1[0] < pm->IRegion.size[0])) {
-        if(LIKELY(0 <= IJK[1] && IJK[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK1[0], IJK[1],  IJK[2],  T[2]*D[0]*T[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK1[0], IJK[1],  IJK1[2], D[2]*D[0]*T[1], pm);
+        for(i = 0; i < nb; i ++) {
+            D[1][i] *= weight[i];
+            T[1][i] *= weight[i];
         }
-        if(LIKELY(0 <= IJK1[1] && IJK1[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK1[0], IJK1[1], IJK[2],  T[2]*D[0]*D[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                WRtPlus(canvas, IJK1[0], IJK1[1], IJK1[2], D[2]*D[0]*D[1], pm);
+
+        /* deposit in the order of particles */
+        for(i = 0; i < nb; i ++) {
+            const int I = IJK[0][i], J = IJK[1][i], K = IJK[2][i];
+            const int I1 = IJK1[0][i], J1 = IJK1[1][i], K1 = IJK1[2][i];
+            if(LIKELY((unsigned) I < size[0])) {
+                if(LIKELY((unsigned) J < size[1])) {
+                    if(LIKELY((unsigned) K < size[2]))
+                        WRtPlus(canvas, I, J,  K,  T[2][i]*T[0][i]*T[1][i], pm);
+                    if(LIKELY((unsigned) K1 < size[2]))
+                        WRtPlus(canvas, I, J,  K1, D[2][i]*T[0][i]*T[1][i], pm);
+                }
+                if(LIKELY((unsigned) J1 < size[1])) {
+                    if(LIKELY((unsigned) K < size[2]))
+                        WRtPlus(canvas, I, J1, K,  T[2][i]*T[0][i]*D[1][i], pm);
+                    if(LIKELY((unsigned) K1 < size[2]))
+                        WRtPlus(canvas, I, J1, K1, D[2][i]*T[0][i]*D[1][i], pm);
+                }
+            }
+            if(LIKELY((unsigned) I1 < size[0])) {
+                if(LIKELY((unsigned) J < size[1])) {
+                    if(LIKELY((unsigned) K < size[2]))
+                        WRtPlus(canvas, I1, J,  K,  T[2][i]*D[0][i]*T[1][i], pm);
+                    if(LIKELY((unsigned) K1 < size[2]))
+                        WRtPlus(canvas, I1, J,  K1, D[2][i]*D[0][i]*T[1][i], pm);
+                }
+                if(LIKELY((unsigned) J1 < size[1])) {
+                    if(LIKELY((unsigned) K < size[2]))
+                        WRtPlus(canvas, I1, J1, K,  T[2][i]*D[0][i]*D[1][i], pm);
+                    if(LIKELY((unsigned) K1 < size[2]))
+                        WRtPlus(canvas, I1, J1, K1, D[2][i]*D[0][i]*D[1][i], pm);
+                }
+            }
         }
     }
 }
 
-static double
-cic_readout_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir)
+/* the weights of a particle are computed once and applied to every canvas */
+static void
+cic_readout_batch(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double (*pos)[3], double * value, int n, int diffdir)
 {
     PM * pm = painter->pm;
-
-    int d;
-
-    double XYZ[3];
-    int IJK[3];
-    int IJK1[3];
-    double D[3];
-    double T[3];
-
-    for(d = 0; d < 3; d ++) {
-        XYZ[d] = pos[d]*pm->InvCellSize[d];
-        // without floor, -1 < X < 0 is mapped to I=0
-        IJK[d] = (int) floor(XYZ[d]);
-        IJK1[d] = IJK[d] + 1;
-    };
-
-    for(d = 0; d < 3; d ++) {
-        D[d] = XYZ[d] - IJK[d];
-        T[d] = 1. - D[d];
-    }
-
-    if(diffdir >= 0) {
-        D[diffdir] = pm->InvCellSize[diffdir];
-        T[diffdir] = -pm->InvCellSize[diffdir];
-    }
-
-
-    // Do periodic wrapup in all directions. 
-    // Buffer particles are copied from adjacent nodes
-    for(d = 0; d < 3; d ++) {
-        while(UNLIKELY(IJK[d] < 0)) IJK[d] += pm->Nmesh[d];
-        while(UNLIKELY(IJK[d] >= pm->Nmesh[d])) IJK[d] -= pm->Nmesh[d];
-        while(UNLIKELY(IJK1[d] < 0)) IJK1[d] += pm->Nmesh[d];
-        while(UNLIKELY(IJK1[d] >= pm->Nmesh[d])) IJK1[d] -= pm->Nmesh[d];
-    }
-
-    /* start[2] == 0 */
-    for(d = 0; d < 2; d ++) {
-        IJK[d] -= pm->IRegion.start[d];
-        IJK1[d] -= pm->IRegion.start[d];
-    }
-
-    double value = 0;
-
-    if(LIKELY(0 <= IJK[0] && IJK[0] < pm->IRegion.size[0])) {
-        if(LIKELY(0 <= IJK[1] && IJK[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK[0], IJK[1],  IJK[2],  T[2]*T[0]*T[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK[0], IJK[1],  IJK1[2], D[2]*T[0]*T[1], pm);
+    int IJK[3][CIC_BATCH];
+    int IJK1[3][CIC_BATCH];
+    double D[3][CIC_BATCH];
+    double T[3][CIC_BATCH];
+    const unsigned int size[3] = {pm->IRegion.size[0], pm->IRegion.size[1], pm->IRegion.size[2]};
+    const ptrdiff_t * strides = pm->IRegion.strides;
+    int offset;
+
+    for(offset = 0; offset < n; offset += CIC_BATCH) {
+        int nb = n - offset < CIC_BATCH ? n - offset : CIC_BATCH;
+        int i, c;
+
+        cic_weights(pm, pos + offset, nb, IJK, IJK1, D, T);
+
+        if(diffdir >= 0) {
+            for(i = 0; i < nb; i ++) {
+                D[diffdir][i] = pm->InvCellSize[diffdir];
+                T[diffdir][i] = -pm->InvCellSize[diffdir];
+            }
         }
-        if(LIKELY(0 <= IJK1[1] && IJK1[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK[0], IJK1[1], IJK[2],  T[2]*T[0]*D[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK[0], IJK1[1], IJK1[2], D[2]*T[0]*D[1], pm);
-        }
-    }
 
-    if(LIKELY(0 <= IJK1[0] && IJK1[0] < pm->IRegion.size[0])) {
-        if(LIKELY(0 <= IJK[1] && IJK[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK1[0], IJK[1],  IJK[2],  T[2]*D[0]*T[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK1[0], IJK[1],  IJK1[2], D[2]*D[0]*T[1], pm);
-        }
-        if(LIKELY(0 <= IJK1[1] && IJK1[1] < pm->IRegion.size[1])) {
-            if(LIKELY(0 <= IJK[2] && IJK[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK1[0], IJK1[1], IJK[2],  T[2]*D[0]*D[1], pm);
-            if(LIKELY(0 <= IJK1[2] && IJK1[2] < pm->IRegion.size[2]))
-                value += REd(canvas, IJK1[0], IJK1[1], IJK1[2], D[2]*D[0]*D[1], pm);
+        for(i = 0; i < nb; i ++) {
+            const int I[2] = {IJK[0][i], IJK1[0][i]};
+            const int J[2] = {IJK[1][i], IJK1[1][i]};
+            const int K[2] = {IJK[2][i], IJK1[2][i]};
+            const double W[3][2] = {
+                {T[0][i], D[0][i]},
+                {T[1][i], D[1][i]},
+                {T[2][i], D[2][i]},
+            };
+            ptrdiff_t ind[8];
+            double w[8];
+            int m = 0;
+            int a, b, e;
+            /* same order of cells as the paint */
+            for(a = 0; a < 2; a ++) {
+                if(UNLIKELY((unsigned) I[a] >= size[0])) continue;
+                for(b = 0; b < 2; b ++) {
+                    if(UNLIKELY((unsigned) J[b] >= size[1])) continue;
+                    for(e = 0; e < 2; e ++) {
+                        if(UNLIKELY((unsigned) K[e] >= size[2])) continue;
+                        ind[m] = K[e] * strides[2] + J[b] * strides[1] + I[a] * strides[0];
+                        w[m] = W[2][e] * W[0][a] * W[1][b];
+                        m ++;
+                    }
+                }
+            }
+            for(c = 0; c < ncanvas; c ++) {
+                const FastPMFloat * canvasc = canvas[c];
+                double v = 0;
+                int j;
+                for(j = 0; j < m; j ++) {
+                    v += canvasc[ind[j]] * w[j];
+                }
+                value[c * n + offset + i] = v;
+            }
         }
     }
-    return value;
 }
 
+static void
+cic_paint_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir)
+{
+    cic_paint_batch(painter, canvas, (double (*)[3]) pos, &weight, 1, diffdir);
+}
+
+static double
+cic_readout_tuned(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir)
+{
+    double value;
+    cic_readout_batch(painter, &canvas, 1, (double (*)[3]) pos, &value, 1, diffdir);
+    return value;
+}
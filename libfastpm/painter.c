@@ -1,10 +1,15 @@
 #include <string.h>
 #include <math.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
 #include "pmpfft.h"
 #include "pmghosts.h"
+#include "pmhalo.h"
 
 /* from cic.c */
 void fastpm_painter_init_cic(FastPMPainter * painter);
@@ -13,6 +18,9 @@ static void
 _generic_paint(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir);
 static double
 _generic_readout(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir);
+static void
+_generic_readout_batch(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+        double (*pos)[3], double * value, int n, int diffdir);
 
 static double
 _linear_kernel(double x, double invh) {
@@ -61,26 +69,6 @@ _quad_diff(double x, double invh) {
 }
 
 
-static inline double __cached__(int *status, double * table, double x, double (*func)(double)){
-    const double dx = 1e-3;
-    const double tablemax = dx * 16384;
-    const double tablemin = dx * 1;
-    if(!*status) {
-        int i;
-        for(i = 0; i < 16384; i ++) {
-            double x = dx * i;
-            table[i] = func(x);
-        }
-        *status = 1;
-    }
-    if(x > tablemin && x < tablemax) {
-        int i = fabs(x) / dx;
-        return table[i];
-    }
-    return func(x);
-}
-
-
 static double __sinc__(double x) {
     x *= 3.1415927;
     if(x < 1e-5 && x > -1e-5) {
@@ -104,26 +92,220 @@ static double __dsinc__(double x) {
     return r;
 }
 
+/* The Lanczos kernels are tabulated for 0 < x < 16.384;
+ * the tables are filled by fastpm_painter_init, before any threads use them. */
+#define LANCZOS_TABLE_SIZE 16384
+#define LANCZOS_TABLE_DX 1e-3
+
+static double _sinc_table[LANCZOS_TABLE_SIZE];
+static double _dsinc_table[LANCZOS_TABLE_SIZE];
+
+static void
+_lanczos_init_tables()
+{
+    static int inited = 0;
+    if(inited) return;
+    int i;
+    for(i = 0; i < LANCZOS_TABLE_SIZE; i ++) {
+        double x = LANCZOS_TABLE_DX * i;
+        _sinc_table[i] = __sinc__(x);
+        _dsinc_table[i] = __dsinc__(x);
+    }
+    inited = 1;
+}
+
+static inline double
+__tabulated__(const double * table, double x, double (*func)(double))
+{
+    const double tablemax = LANCZOS_TABLE_DX * LANCZOS_TABLE_SIZE;
+    const double tablemin = LANCZOS_TABLE_DX * 1;
+    if(x > tablemin && x < tablemax) {
+        int i = x / LANCZOS_TABLE_DX;
+        return table[i];
+    }
+    return func(x);
+}
+
 static double
 _lanczos_kernel(double x, double invh) {
-    static int status = 0;
-    static double table[16384];
-    double s1 = __cached__(&status, table, x, __sinc__);
-    double s2 = __cached__(&status, table, x * invh, __sinc__);
+    double s1 = __tabulated__(_sinc_table, x, __sinc__);
+    double s2 = __tabulated__(_sinc_table, x * invh, __sinc__);
     return s1 * s2;
 }
 
 static double
 _lanczos_diff(double x, double invh) {
-    static int status = 0;
-    static double table[16384];
-    double u1 = __cached__(&status, table, x, __sinc__);
-    double u2 = __cached__(&status, table, x, __dsinc__);
-    double v1 = __cached__(&status, table, x * invh, __sinc__);
-    double v2 = __cached__(&status, table, x * invh, __dsinc__) * invh;
+    double u1 = __tabulated__(_sinc_table, x, __sinc__);
+    double u2 = __tabulated__(_dsinc_table, x, __dsinc__);
+    double v1 = __tabulated__(_sinc_table, x * invh, __sinc__);
+    double v2 = __tabulated__(_dsinc_table, x * invh, __dsinc__) * invh;
     return u1 * v2 + u2 * v1;
 }
 
+/*
+ * Painters with the kernel and the support known at compile time.
+ *
+ * The kernel calls are inlined and the loops over the support are unrolled;
+ * the periodic wrap-up is done once per dimension instead of once per point.
+ * The order of the floating point operations is the same as in _generic_paint
+ * and _generic_readout.
+ * */
+#define FIXED_MAX_SUPPORT 8
+
+static inline __attribute__((always_inline)) void
+_fill_k_fixed(FastPMPainter * painter, double pos[3], double k[3][FIXED_MAX_SUPPORT],
+        ptrdiff_t offset[3][FIXED_MAX_SUPPORT], int diffdir,
+        fastpm_kernelfunc kernel, fastpm_kernelfunc diff, const int support)
+{
+    PM * pm = painter->pm;
+    int d;
+    for(d = 0; d < 3; d++) {
+        double gpos = pos[d] * pm->InvCellSize[d];
+        int ipos = floor(gpos + painter->shift) - painter->left;
+        double dx = gpos - ipos;
+        int i;
+        double sum = 0;
+        for(i = 0; i < support; i ++) {
+            k[d][i] = kernel(dx - i, painter->invh);
+            sum += k[d][i];
+            if(d == diffdir) {
+                k[d][i] = diff(dx - i, painter->invh) * pm->InvCellSize[d];
+            }
+        }
+        for(i = 0; i < support; i ++) {
+            k[d][i] /= sum;
+        }
+        ipos -= pm->IRegion.start[d];
+        /* offset into the canvas; -1 if outside of the local region */
+        for(i = 0; i < support; i ++) {
+            int targetpos = ipos + i;
+            while(targetpos >= pm->Nmesh[d]) {
+                targetpos -= pm->Nmesh[d];
+            }
+            while(targetpos < 0) {
+                targetpos += pm->Nmesh[d];
+            }
+            if(UNLIKELY(targetpos >= pm->IRegion.size[d])) {
+                offset[d][i] = -1;
+            } else {
+                offset[d][i] = pm->IRegion.strides[d] * targetpos;
+            }
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void
+_paint_fixed(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir,
+        fastpm_kernelfunc kernel, fastpm_kernelfunc diff, const int support)
+{
+    double k[3][FIXED_MAX_SUPPORT];
+    ptrdiff_t offset[3][FIXED_MAX_SUPPORT];
+
+    _fill_k_fixed(painter, pos, k, offset, diffdir, kernel, diff, support);
+
+    int i, j, l;
+    for(i = 0; i < support; i ++) {
+        if(UNLIKELY(offset[0][i] < 0)) continue;
+        for(j = 0; j < support; j ++) {
+            if(UNLIKELY(offset[1][j] < 0)) continue;
+            const double kij = k[0][i] * k[1][j];
+            const ptrdiff_t oij = offset[0][i] + offset[1][j];
+            for(l = 0; l < support; l ++) {
+                if(UNLIKELY(offset[2][l] < 0)) continue;
+                canvas[oij + offset[2][l]] += weight * (kij * k[2][l]);
+            }
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void
+_readout_fixed(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double pos[3], double * value, int diffdir,
+        fastpm_kernelfunc kernel, fastpm_kernelfunc diff, const int support)
+{
+    double k[3][FIXED_MAX_SUPPORT];
+    ptrdiff_t offset[3][FIXED_MAX_SUPPORT];
+    int c;
+
+    _fill_k_fixed(painter, pos, k, offset, diffdir, kernel, diff, support);
+
+    for(c = 0; c < ncanvas; c ++) {
+        const FastPMFloat * canvasc = canvas[c];
+        double v = 0;
+        int i, j, l;
+        for(i = 0; i < support; i ++) {
+            if(UNLIKELY(offset[0][i] < 0)) continue;
+            for(j = 0; j < support; j ++) {
+                if(UNLIKELY(offset[1][j] < 0)) continue;
+                const double kij = k[0][i] * k[1][j];
+                const ptrdiff_t oij = offset[0][i] + offset[1][j];
+                for(l = 0; l < support; l ++) {
+                    if(UNLIKELY(offset[2][l] < 0)) continue;
+                    v += (kij * k[2][l]) * canvasc[oij + offset[2][l]];
+                }
+            }
+        }
+        value[c] = v;
+    }
+}
+
+#define DEFINE_FIXED_PAINTER(name, kernel, diff, support) \
+static void \
+name ## _paint_ ## support(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir) \
+{ \
+    _paint_fixed(painter, canvas, pos, weight, diffdir, kernel, diff, support); \
+} \
+static double \
+name ## _readout_ ## support(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir) \
+{ \
+    double value; \
+    _readout_fixed(painter, &canvas, 1, pos, &value, diffdir, kernel, diff, support); \
+    return value; \
+} \
+static void \
+name ## _readout_batch_ ## support(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, \
+        double (*pos)[3], double * value, int n, int diffdir) \
+{ \
+    double v[ncanvas]; \
+    int i, c; \
+    for(i = 0; i < n; i ++) { \
+        _readout_fixed(painter, canvas, ncanvas, pos[i], v, diffdir, kernel, diff, support); \
+        for(c = 0; c < ncanvas; c ++) { \
+            value[c * n + i] = v[c]; \
+        } \
+    } \
+}
+
+DEFINE_FIXED_PAINTER(_linear, _linear_kernel, _linear_diff, 2)
+DEFINE_FIXED_PAINTER(_quad, _quad_kernel, _quad_diff, 3)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 2)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 3)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 4)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 5)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 6)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 7)
+DEFINE_FIXED_PAINTER(_lanczos, _lanczos_kernel, _lanczos_diff, 8)
+
+struct FixedPainter {
+    void   (*paint)(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], double weight, int diffdir);
+    double (*readout)(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir);
+    void   (*readout_batch)(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double (*pos)[3], double * value, int n, int diffdir);
+};
+
+#define FIXED_PAINTER(name, support) \
+    { name ## _paint_ ## support, name ## _readout_ ## support, name ## _readout_batch_ ## support }
+
+static const struct FixedPainter _linear_fixed = FIXED_PAINTER(_linear, 2);
+static const struct FixedPainter _quad_fixed = FIXED_PAINTER(_quad, 3);
+static const struct FixedPainter _lanczos_fixed[FIXED_MAX_SUPPORT + 1] = {
+    [2] = FIXED_PAINTER(_lanczos, 2),
+    [3] = FIXED_PAINTER(_lanczos, 3),
+    [4] = FIXED_PAINTER(_lanczos, 4),
+    [5] = FIXED_PAINTER(_lanczos, 5),
+    [6] = FIXED_PAINTER(_lanczos, 6),
+    [7] = FIXED_PAINTER(_lanczos, 7),
+    [8] = FIXED_PAINTER(_lanczos, 8),
+};
+
 void
 fastpm_painter_init(FastPMPainter * painter, PM * pm,
     FastPMPainterType type, int support)
@@ -131,34 +313,58 @@ fastpm_painter_init(FastPMPainter * painter, PM * pm,
     painter->pm = pm;
     painter->paint = _generic_paint;
     painter->readout = _generic_readout;
+    painter->paint_batch = NULL;
+    painter->readout_batch = _generic_readout_batch;
+
+    const struct FixedPainter * fixed = NULL;
 
     switch(type) {
         case FASTPM_PAINTER_CIC:
             fastpm_painter_init_cic(painter);
             painter->kernel = NULL;
             painter->diff = NULL;
+            support = 2;
         break;
         case FASTPM_PAINTER_LINEAR:
             painter->kernel = _linear_kernel;
             painter->diff = _linear_diff;
             support = 2;
+            fixed = &_linear_fixed;
         break;
         case FASTPM_PAINTER_QUAD:
             painter->kernel = _quad_kernel;
             painter->diff = _quad_diff;
             support = 3;
+            fixed = &_quad_fixed;
         break;
         case FASTPM_PAINTER_LANCZOS:
+            _lanczos_init_tables();
             painter->kernel = _lanczos_kernel;
             painter->diff = _lanczos_diff;
+            if(support >= 2 && support <= FIXED_MAX_SUPPORT) {
+                fixed = &_lanczos_fixed[support];
+            }
         break;
     }
 
+    if(support < 1 || support > 64) {
+        fastpm_raise(-1, "Painter support must be between 1 and 64, got %d\n", support);
+    }
+
+    if(fixed) {
+        painter->paint = fixed->paint;
+        painter->readout = fixed->readout;
+        painter->readout_batch = fixed->readout_batch;
+    }
+
     painter->support = support;
     painter->hsupport = 0.5 * support;
     painter->invh= 1 / (0.5 * support);
     painter->left = (support  - 1) / 2;
     painter->diffdir = -1;
+    painter->offset[0] = 0;
+    painter->offset[1] = 0;
+    painter->offset[2] = 0;
     int nmax = 1;
     int d;
     for(d = 0; d < 3; d++) {
@@ -244,7 +450,7 @@ _generic_paint(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], dou
                 goto outside;
             ind += pm->IRegion.strides[d] * targetpos;
         }
-#pragma omp atomic
+        /* no atomic: fastpm_paint_local never runs two overlapping particles concurrently. */
         canvas[ind] += weight * kernel;
 
     outside:
@@ -262,16 +468,21 @@ _generic_paint(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], dou
     return;
 }
 
-static double
-_generic_readout(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir)
+/* read out ncanvas meshes at the same position; the kernel is evaluated once. */
+static void
+_generic_readout_multi(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas, double pos[3], double * value, int diffdir)
 {
     PM * pm = painter->pm;
-    double value = 0;
     int ipos[3];
     double k[3][64];
+    int c;
 
     _fill_k(painter, pos, ipos, k, diffdir);
 
+    for(c = 0; c < ncanvas; c ++) {
+        value[c] = 0;
+    }
+
     int rel[3] = {0, 0, 0};
 
     int s2 = painter->support;
@@ -299,7 +510,9 @@ _generic_readout(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], i
                 goto outside;
             ind += pm->IRegion.strides[d] * targetpos;
         }
-        value += kernel * canvas[ind];
+        for(c = 0; c < ncanvas; c ++) {
+            value[c] += kernel * canvas[c][ind];
+        }
 outside:
         rel[2] ++;
         if(UNLIKELY(rel[2] == s2)) {
@@ -312,29 +525,254 @@ outside:
         }
         continue;
     }
+}
+
+static double
+_generic_readout(FastPMPainter * painter, FastPMFloat * canvas, double pos[3], int diffdir)
+{
+    double value;
+    _generic_readout_multi(painter, &canvas, 1, pos, &value, diffdir);
     return value;
 }
 
-void
-fastpm_paint_local(FastPMPainter * painter, FastPMFloat * canvas,
+static void
+_generic_readout_batch(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+        double (*pos)[3], double * value, int n, int diffdir)
+{
+    double v[ncanvas];
+    int i, c;
+    for(i = 0; i < n; i ++) {
+        _generic_readout_multi(painter, canvas, ncanvas, pos[i], v, diffdir);
+        for(c = 0; c < ncanvas; c ++) {
+            value[c * n + i] = v[c];
+        }
+    }
+}
+
+static inline void
+_get_position(FastPMPainter * painter, fastpm_posfunc get_position, FastPMStore * p, ptrdiff_t i, double pos[3])
+{
+    get_position(p, i, pos);
+    pos[0] += painter->offset[0];
+    pos[1] += painter->offset[1];
+    pos[2] += painter->offset[2];
+}
+
+/*
+ * Painting is done in tiles to avoid atomics.
+ *
+ * The local mesh is cut into tiles along x and y; a tile is at least
+ * as wide as the kernel support, thus a particle binned to a tile (by the
+ * first cell it touches) never reaches the tile after the next one.
+ * The tiles are painted in four phases by the parity of (tx, ty); within a phase
+ * the tiles are disjoint and each is painted by a single thread, with its particles
+ * in the order of the store.
+ *
+ * The tiling depends only on the mesh and the support, so the
+ * order of additions to any cell, and hence the result, does not depend on
+ * the number of threads.
+ * */
+#define PAINT_TILE_WIDTH 8
+
+/* number of particles passed to the batched painters per call */
+#define PAINT_BATCH 64
+
+static int
+_paint_ntiles(FastPMPainter * painter, int d, int width)
+{
+    PM * pm = painter->pm;
+    ptrdiff_t size = pm->IRegion.size[d];
+    int n = size / width;
+
+    if(n < 1) n = 1;
+
+    if(size == pm->Nmesh[d]) {
+        /* the kernel wraps from the last tile to the first; the two must be
+         * painted in different phases. */
+        if(n > 1 && n % 2 == 1) n --;
+    } else
+    if(size + width > pm->Nmesh[d]) {
+        /* tiny mesh: the kernel may touch both edges of the local region. */
+        n = 1;
+    }
+    return n;
+}
+
+/* returns the tile of a particle; or Ntiles if the particle does not touch the local mesh. */
+static int
+_paint_tile(FastPMPainter * painter, double pos[3], int ntiles[2])
+{
+    PM * pm = painter->pm;
+    int t[2];
+    int d;
+    for(d = 0; d < 2; d ++) {
+        ptrdiff_t size = pm->IRegion.size[d];
+        ptrdiff_t i0 = floor(pos[d] * pm->InvCellSize[d] + painter->shift) - painter->left;
+        ptrdiff_t rel = (i0 - pm->IRegion.start[d]) % pm->Nmesh[d];
+
+        if(rel < 0) rel += pm->Nmesh[d];
+
+        if(rel >= size) {
+            /* might touch the lower edge of the local region */
+            if(rel - pm->Nmesh[d] + painter->support <= 0) {
+                return ntiles[0] * ntiles[1];
+            }
+            rel = 0;
+        }
+        /* tile edges are at i * size / ntiles */
+        t[d] = ((rel + 1) * ntiles[d] - 1) / size;
+    }
+    return t[0] * ntiles[1] + t[1];
+}
+
+/* adds the particles to canvas */
+static void
+_paint_local(FastPMPainter * painter, FastPMFloat * canvas,
     FastPMStore * p, size_t size,
     fastpm_posfunc get_position, enum FastPMPackFields attribute)
 {
-    ptrdiff_t i;
-
-    memset(canvas, 0, sizeof(canvas[0]) * painter->pm->allocsize);
+    PM * pm = painter->pm;
 
     if(get_position == NULL) {
         get_position = p->get_position;
     }
 
-#pragma omp parallel for
-    for (i = 0; i < size; i ++) {
-        double pos[3];
-        double weight = attribute? p->to_double(p, i, attribute): 1.0;
-        get_position(p, i, pos);
-        painter->paint(painter, canvas, pos, weight, painter->diffdir);
+    int width = PAINT_TILE_WIDTH;
+    if(painter->support > width) width = painter->support;
+
+    int ntiles[2];
+    ntiles[0] = _paint_ntiles(painter, 0, width);
+    ntiles[1] = _paint_ntiles(painter, 1, width);
+
+    /* the last bin holds particles that do not touch the local mesh */
+    int Ntiles = ntiles[0] * ntiles[1];
+    int nbins = Ntiles + 1;
+
+#ifdef _OPENMP
+    int MaxThreads = omp_get_max_threads();
+#else
+    int MaxThreads = 1;
+#endif
+
+    int * tile = fastpm_memory_alloc(pm->mem, sizeof(int) * size, FASTPM_MEMORY_STACK);
+    ptrdiff_t * order = fastpm_memory_alloc(pm->mem, sizeof(ptrdiff_t) * size, FASTPM_MEMORY_STACK);
+    ptrdiff_t * tilestart = fastpm_memory_alloc(pm->mem, sizeof(ptrdiff_t) * (nbins + 1), FASTPM_MEMORY_STACK);
+    ptrdiff_t * count = fastpm_memory_alloc(pm->mem, sizeof(ptrdiff_t) * nbins * MaxThreads, FASTPM_MEMORY_STACK);
+
+    /* stable counting sort by tile; each thread bins a contiguous chunk. */
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+        int nth = omp_get_num_threads();
+        int ith = omp_get_thread_num();
+#else
+        int nth = 1;
+        int ith = 0;
+#endif
+        ptrdiff_t start = ith * size / nth;
+        ptrdiff_t end = (ith + 1) * size / nth;
+        ptrdiff_t * mycount = count + ith * nbins;
+        ptrdiff_t i;
+        int b;
+
+        for(b = 0; b < nbins; b ++) {
+            mycount[b] = 0;
+        }
+
+        for(i = start; i < end; i ++) {
+            double pos[3];
+            _get_position(painter, get_position, p, i, pos);
+            tile[i] = _paint_tile(painter, pos, ntiles);
+            mycount[tile[i]] ++;
+        }
+
+#pragma omp barrier
+#pragma omp single
+        {
+            ptrdiff_t offset = 0;
+            int t;
+            for(b = 0; b < nbins; b ++) {
+                tilestart[b] = offset;
+                for(t = 0; t < nth; t ++) {
+                    ptrdiff_t c = count[t * nbins + b];
+                    count[t * nbins + b] = offset;
+                    offset += c;
+                }
+            }
+            tilestart[nbins] = offset;
+        }
+
+        for(i = start; i < end; i ++) {
+            order[mycount[tile[i]]++] = i;
+        }
+    }
+
+    int phase;
+    for(phase = 0; phase < 4; phase ++) {
+        int it;
+#pragma omp parallel for schedule(dynamic, 1)
+        for(it = 0; it < Ntiles; it ++) {
+            int tx = it / ntiles[1];
+            int ty = it % ntiles[1];
+            if((tx % 2) * 2 + (ty % 2) != phase) continue;
+
+            ptrdiff_t j;
+            for(j = tilestart[it]; j < tilestart[it + 1]; j += PAINT_BATCH) {
+                double pos[PAINT_BATCH][3];
+                double weight[PAINT_BATCH];
+                int n = tilestart[it + 1] - j;
+                int k;
+                if(n > PAINT_BATCH) n = PAINT_BATCH;
+
+                for(k = 0; k < n; k ++) {
+                    ptrdiff_t i = order[j + k];
+                    weight[k] = attribute? p->to_double(p, i, attribute): 1.0;
+                    _get_position(painter, get_position, p, i, pos[k]);
+                }
+                if(painter->paint_batch) {
+                    painter->paint_batch(painter, canvas, pos, weight, n, painter->diffdir);
+                } else {
+                    for(k = 0; k < n; k ++) {
+                        painter->paint(painter, canvas, pos[k], weight[k], painter->diffdir);
+                    }
+                }
+            }
+        }
     }
+
+    fastpm_memory_free(pm->mem, count);
+    fastpm_memory_free(pm->mem, tilestart);
+    fastpm_memory_free(pm->mem, order);
+    fastpm_memory_free(pm->mem, tile);
+}
+
+void
+fastpm_paint_local(FastPMPainter * painter, FastPMFloat * canvas,
+    FastPMStore * p, size_t size,
+    fastpm_posfunc get_position, enum FastPMPackFields attribute)
+{
+    PM * pm = painter->pm;
+
+    memset(canvas, 0, sizeof(canvas[0]) * pm->allocsize);
+
+    _paint_local(painter, canvas, p, size, get_position, attribute);
+}
+
+/* Paint the local particles of pgd and then their ghosts from the ghost store. */
+void
+pm_ghosts_paint(PMGhostData * pgd, FastPMPainter * painter, FastPMFloat * canvas,
+    enum FastPMPackFields attribute)
+{
+    fastpm_paint_local(painter, canvas, pgd->p, pgd->np, pgd->get_position, attribute);
+    _paint_local(painter, canvas, pgd->ghosts, pgd->nghosts, NULL, attribute);
+}
+
+void
+pm_ghosts_readout_multi(PMGhostData * pgd, FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+    enum FastPMPackFields * attributes)
+{
+    fastpm_readout_local_multi(painter, canvas, ncanvas, pgd->p, pgd->np, pgd->get_position, attributes);
+    fastpm_readout_local_multi(painter, canvas, ncanvas, pgd->ghosts, pgd->nghosts, NULL, attributes);
 }
 
 void
@@ -345,9 +783,17 @@ fastpm_paint(FastPMPainter * painter, FastPMFloat * canvas,
         get_position = p->get_position;
     }
 
-    PMGhostData * pgd = pm_ghosts_create(painter->pm, p, p->attributes, get_position);
+    if(painter->pm->init.mesh_halo) {
+        PMHalo halo[1];
+        pm_halo_init(halo, painter->pm, painter->support);
+        pm_halo_paint(halo, painter, canvas, p, get_position, attribute);
+        pm_halo_destroy(halo);
+        return;
+    }
 
-    fastpm_paint_local(painter, canvas, p, p->np + pgd->nghosts, get_position, attribute);
+    PMGhostData * pgd = pm_ghosts_create(painter->pm, p, PACK_POS | attribute, 0, get_position);
+
+    pm_ghosts_paint(pgd, painter, canvas, attribute);
 
     pm_ghosts_free(pgd);
 }
@@ -357,17 +803,36 @@ fastpm_readout_local(FastPMPainter * painter, FastPMFloat * canvas,
     FastPMStore * p, size_t size,
     fastpm_posfunc get_position, enum FastPMPackFields attribute)
 {
+    fastpm_readout_local_multi(painter, &canvas, 1, p, size, get_position, &attribute);
+}
 
+void
+fastpm_readout_local_multi(FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+    FastPMStore * p, size_t size,
+    fastpm_posfunc get_position, enum FastPMPackFields * attributes)
+{
     ptrdiff_t i;
     if(get_position == NULL) {
         get_position = p->get_position;
     }
 #pragma omp parallel for
-    for (i = 0; i < size; i ++) {
-        double pos[3];
-        get_position(p, i, pos);
-        double weight = painter->readout(painter, canvas, pos, painter->diffdir);
-        p->from_double(p, i, attribute, weight);
+    for (i = 0; i < size; i += PAINT_BATCH) {
+        double pos[PAINT_BATCH][3];
+        double value[ncanvas * PAINT_BATCH];
+        int n = size - i;
+        int k, c;
+        if(n > PAINT_BATCH) n = PAINT_BATCH;
+
+        for(k = 0; k < n; k ++) {
+            _get_position(painter, get_position, p, i + k, pos[k]);
+        }
+        painter->readout_batch(painter, canvas, ncanvas, pos, value, n, painter->diffdir);
+
+        for(c = 0; c < ncanvas; c ++) {
+            for(k = 0; k < n; k ++) {
+                p->from_double(p, i + k, attributes[c], value[c * n + k]);
+            }
+        }
     }
 }
 
@@ -379,9 +844,17 @@ fastpm_readout(FastPMPainter * painter, FastPMFloat * canvas,
         get_position = p->get_position;
     }
 
-    PMGhostData * pgd = pm_ghosts_create(painter->pm, p, p->attributes, get_position);
+    if(painter->pm->init.mesh_halo) {
+        PMHalo halo[1];
+        pm_halo_init(halo, painter->pm, painter->support);
+        pm_halo_readout_multi(halo, painter, &canvas, 1, p, get_position, &attribute);
+        pm_halo_destroy(halo);
+        return;
+    }
+
+    PMGhostData * pgd = pm_ghosts_create(painter->pm, p, PACK_POS, attribute, get_position);
 
-    fastpm_readout_local(painter, canvas, p, p->np + pgd->nghosts, get_position, attribute);
+    pm_ghosts_readout_multi(pgd, painter, &canvas, 1, &attribute);
 
     pm_ghosts_reduce(pgd, attribute);
     pm_ghosts_free(pgd);
@@ -0,0 +1,5 @@
+/* Permute the arrays data[c] of elsize[c] bytes per item in place,
+ * OUT[i] = IN[ind[i]]; the columns are permuted in parallel. */
+void
+fastpm_permute(void ** data, size_t * elsize, int ncolumns,
+    ptrdiff_t np, int * ind, FastPMMemory * mem);
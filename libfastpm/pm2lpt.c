@@ -23,12 +23,15 @@ pm_2lpt_solve(PM * pm, FastPMFloat * delta_k, FastPMStore * p, double shift[3])
      * Because we will read out from the (de-)shifted positions.
      * Otherwise the IC will have artifacts along the edges of domains. */
     for(i = 0; i < p->np; i ++) {
+        double pos[3];
+        p->get_position(p, i, pos);
         for(d = 0; d < 3; d ++) {
-            p->x[i][d] -= shift[d];
+            pos[d] -= shift[d];
         }
+        fastpm_store_set_position(p, i, pos);
     }
 
-    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, NULL);
+    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, PACK_DX1 | PACK_DX2, NULL);
 
     FastPMPainter painter[1];
     fastpm_painter_init(painter, pm, FASTPM_PAINTER_CIC, 0);
@@ -42,8 +45,8 @@ pm_2lpt_solve(PM * pm, FastPMFloat * delta_k, FastPMStore * p, double shift[3])
     for(d = 0; d < 3; d++ )
         field[d] = pm_alloc(pm);
 
-    int DX1[] = {PACK_DX1_X, PACK_DX1_Y, PACK_DX1_Z};
-    int DX2[] = {PACK_DX2_X, PACK_DX2_Y, PACK_DX2_Z};
+    enum FastPMPackFields DX1[] = {PACK_DX1_X, PACK_DX1_Y, PACK_DX1_Z};
+    enum FastPMPackFields DX2[] = {PACK_DX2_X, PACK_DX2_Y, PACK_DX2_Z};
     int D1[] = {1, 2, 0};
     int D2[] = {2, 0, 1};
 
@@ -54,11 +57,11 @@ pm_2lpt_solve(PM * pm, FastPMFloat * delta_k, FastPMStore * p, double shift[3])
 
         pm_c2r(pm, workspace);
 
-        fastpm_readout_local(painter, workspace, p, p->np + pgd->nghosts, NULL, DX1[d]);
-
-        pm_ghosts_reduce(pgd, DX1[d]);
+        pm_ghosts_readout_multi(pgd, painter, &workspace, 1, &DX1[d]);
     } 
 
+    pm_ghosts_reduce(pgd, DX1[0] | DX1[1] | DX1[2]);
+
     for(d = 0; d< 3; d++) {
         fastpm_apply_laplace_transfer(pm, delta_k, field[d]);
         fastpm_apply_diff_transfer(pm, field[d], field[d], d);
@@ -106,18 +109,23 @@ pm_2lpt_solve(PM * pm, FastPMFloat * delta_k, FastPMStore * p, double shift[3])
         /* this ensures x = x0 + dx1(t) + dx2(t) */
         fastpm_apply_multiply_transfer(pm, workspace, workspace, 3.0 / 7);
 
-        fastpm_readout_local(painter, workspace, p, p->np + pgd->nghosts, NULL, DX2[d]);
+        pm_ghosts_readout_multi(pgd, painter, &workspace, 1, &DX2[d]);
     }
 
+    pm_ghosts_reduce(pgd, DX2[0] | DX2[1] | DX2[2]);
+
 #ifdef PM_2LPT_DUMP
     fwrite(p->dx1, sizeof(p->dx1[0]), p->np, fopen("dx1.f4x3", "w"));
     fwrite(p->dx2, sizeof(p->dx2[0]), p->np, fopen("dx2.f4x3", "w"));
 #endif
 
     for(i = 0; i < p->np; i ++) {
+        double pos[3];
+        p->get_position(p, i, pos);
         for(d = 0; d < 3; d ++) {
-            p->x[i][d] += shift[d];
+            pos[d] += shift[d];
         }
+        fastpm_store_set_position(p, i, pos);
     }
 
     for(d = 0; d < 3; d ++) {
@@ -149,13 +157,16 @@ pm_2lpt_evolve(double aout, FastPMStore * p, FastPMCosmology * c, int zaonly)
     int i;
 #pragma omp parallel for
     for(i=0; i<np; i++) {
+        double pos[3];
+        p->get_position(p, i, pos);
         int d;
         for(d = 0; d < 3; d ++) {
-            p->x[i][d] += D1 * p->dx1[i][d] + D2 * p->dx2[i][d];
+            pos[d] += D1 * p->dx1[i][d] + D2 * p->dx2[i][d];
 
             if(p->v)
                 p->v[i][d] = (p->dx1[i][d]* Dv1 + p->dx2[i][d]*Dv2);
         }
+        fastpm_store_set_position(p, i, pos);
     }
     p->a_x = p->a_v = aout;
 }
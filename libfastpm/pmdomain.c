@@ -0,0 +1,434 @@
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
+#include "pmpfft.h"
+#include "pmhalo.h"
+#include "pmdomain.h"
+
+/* rows (all cells along the last axis) of a patch to the pencils of the mesh */
+struct PMDomainRoute {
+    int * sendcounts;
+    int * sdispls;
+    int * recvcounts;
+    int * rdispls;
+    ptrdiff_t * sendrow; /* offset of the rows in the patch, ordered by the owning rank */
+    ptrdiff_t * recvrow; /* offset of the rows in the local mesh, ordered by the patch rank */
+    size_t nsend;
+    size_t nrecv;
+};
+
+static inline ptrdiff_t
+_wrap(ptrdiff_t i, ptrdiff_t n)
+{
+    while(i < 0) i += n;
+    while(i >= n) i -= n;
+    return i;
+}
+
+/* the cell of a position along axis d, in [0, Nmesh[d]) */
+static inline ptrdiff_t
+_pos_to_cell(PM * pm, double pos[3], int d)
+{
+    return _wrap(floor(pos[d] * pm->InvCellSize[d]), pm->Nmesh[d]);
+}
+
+/* Cut n cells with counts hist into nparts of about equal counts; each part has
+ * at least one and at most maxsize cells. */
+static void
+_balance_cuts(int64_t * hist, ptrdiff_t n, int nparts, ptrdiff_t maxsize, ptrdiff_t * edges)
+{
+    int64_t total = 0;
+    ptrdiff_t i;
+    for(i = 0; i < n; i ++) {
+        total += hist[i];
+    }
+
+    edges[0] = 0;
+    edges[nparts] = n;
+
+    int64_t cum = 0;
+    i = 0;
+    int k;
+    for(k = 1; k < nparts; k ++) {
+        int64_t goal = total * k / nparts;
+        while(i < n && cum + hist[i] <= goal) {
+            cum += hist[i];
+            i ++;
+        }
+        /* the closer of the two edges around the goal */
+        if(i < n && goal - cum > cum + hist[i] - goal) {
+            cum += hist[i];
+            i ++;
+        }
+
+        ptrdiff_t lo = edges[k - 1] + 1;
+        ptrdiff_t hi = n - (nparts - k);
+        if(lo < n - (nparts - k) * maxsize) lo = n - (nparts - k) * maxsize;
+        if(hi > edges[k - 1] + maxsize) hi = edges[k - 1] + maxsize;
+
+        ptrdiff_t e = i;
+        if(e < lo) e = lo;
+        if(e > hi) e = hi;
+        edges[k] = e;
+
+        while(i < e) {
+            cum += hist[i];
+            i ++;
+        }
+        while(i > e) {
+            i --;
+            cum -= hist[i];
+        }
+    }
+}
+
+/* count the particles per cell of axis d; along axis 1 per slab of the domain. */
+static void
+_histogram(PMDomain * domain, FastPMStore * p, int d, int64_t * hist, size_t nbins)
+{
+    PM * pm = domain->pm;
+
+    memset(hist, 0, sizeof(hist[0]) * nbins);
+
+#pragma omp parallel
+    {
+        int64_t * myhist = calloc(nbins, sizeof(int64_t));
+        ptrdiff_t i;
+#pragma omp for
+        for(i = 0; i < p->np; i ++) {
+            double pos[3];
+            p->get_position(p, i, pos);
+            ptrdiff_t bin = _pos_to_cell(pm, pos, d);
+            if(d == 1) {
+                bin += domain->MeshtoCart[0][_pos_to_cell(pm, pos, 0)] * pm->Nmesh[1];
+            }
+            myhist[bin] ++;
+        }
+#pragma omp critical
+        {
+            size_t b;
+            for(b = 0; b < nbins; b ++) {
+                hist[b] += myhist[b];
+            }
+        }
+        free(myhist);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, hist, nbins, MPI_LONG_LONG, MPI_SUM, pm->Comm2D);
+}
+
+static PMDomain *
+pm_domain_create(PM * pm)
+{
+    PMDomain * domain = malloc(sizeof(domain[0]));
+    domain->pm = pm;
+    domain->width = 0;
+    domain->edges[0] = malloc(sizeof(ptrdiff_t) * (pm->Nproc[0] + 1));
+    domain->edges[1] = malloc(sizeof(ptrdiff_t) * pm->Nproc[0] * (pm->Nproc[1] + 1));
+    domain->MeshtoCart[0] = malloc(sizeof(int) * pm->Nmesh[0]);
+    domain->MeshtoCart[1] = malloc(sizeof(int) * pm->Nproc[0] * pm->Nmesh[1]);
+    return domain;
+}
+
+void
+pm_domain_free(PMDomain * domain)
+{
+    free(domain->MeshtoCart[1]);
+    free(domain->MeshtoCart[0]);
+    free(domain->edges[1]);
+    free(domain->edges[0]);
+    free(domain);
+}
+
+void
+pm_domain_balance(PM * pm, FastPMStore * p, int width)
+{
+    if(pm->Domain == NULL) {
+        pm->Domain = pm_domain_create(pm);
+    }
+    PMDomain * domain = pm->Domain;
+    domain->width = width;
+
+    /* a patch shall not hold a row of the mesh twice */
+    ptrdiff_t maxsize[2];
+    int d;
+    for(d = 0; d < 2; d ++) {
+        maxsize[d] = pm->Nmesh[d];
+        if(pm->Nproc[d] > 1) maxsize[d] -= 2 * width;
+        if(maxsize[d] * pm->Nproc[d] < pm->Nmesh[d]) {
+            fastpm_raise(-1, "The mesh of %td cells is too small for %d balanced domains with a halo of %d cells along axis %d.\n",
+                pm->Nmesh[d], pm->Nproc[d], width, d);
+        }
+    }
+
+    int64_t * hist = malloc(sizeof(int64_t) * pm->Nproc[0] * pm->Nmesh[1]);
+    ptrdiff_t i;
+    int c0, c1;
+
+    _histogram(domain, p, 0, hist, pm->Nmesh[0]);
+    _balance_cuts(hist, pm->Nmesh[0], pm->Nproc[0], maxsize[0], domain->edges[0]);
+    for(c0 = 0; c0 < pm->Nproc[0]; c0 ++) {
+        for(i = domain->edges[0][c0]; i < domain->edges[0][c0 + 1]; i ++) {
+            domain->MeshtoCart[0][i] = c0;
+        }
+    }
+
+    _histogram(domain, p, 1, hist, pm->Nproc[0] * pm->Nmesh[1]);
+    for(c0 = 0; c0 < pm->Nproc[0]; c0 ++) {
+        ptrdiff_t * edges = domain->edges[1] + c0 * (pm->Nproc[1] + 1);
+        int * cart = domain->MeshtoCart[1] + c0 * pm->Nmesh[1];
+        _balance_cuts(hist + c0 * pm->Nmesh[1], pm->Nmesh[1], pm->Nproc[1], maxsize[1], edges);
+        for(c1 = 0; c1 < pm->Nproc[1]; c1 ++) {
+            for(i = edges[c1]; i < edges[c1 + 1]; i ++) {
+                cart[i] = c1;
+            }
+        }
+    }
+    free(hist);
+}
+
+int
+pm_domain_pos_to_rank(PMDomain * domain, double pos[3])
+{
+    PM * pm = domain->pm;
+    int c0 = domain->MeshtoCart[0][_pos_to_cell(pm, pos, 0)];
+    int c1 = domain->MeshtoCart[1][c0 * pm->Nmesh[1] + _pos_to_cell(pm, pos, 1)];
+    return c0 * pm->Nproc[1] + c1;
+}
+
+int
+FastPMTargetDomain(FastPMStore * p, ptrdiff_t i, PMDomain * domain)
+{
+    double pos[3];
+    p->get_position(p, i, pos);
+    return pm_domain_pos_to_rank(domain, pos);
+}
+
+/* the box of the patch of rank: start and size along the first two axes */
+static void
+_patch_box(PMDomain * domain, int rank, ptrdiff_t width[2], ptrdiff_t start[2], ptrdiff_t size[2])
+{
+    PM * pm = domain->pm;
+    int c0 = rank / pm->Nproc[1];
+    int c1 = rank % pm->Nproc[1];
+    ptrdiff_t * edges1 = domain->edges[1] + c0 * (pm->Nproc[1] + 1);
+
+    start[0] = domain->edges[0][c0] - width[0];
+    size[0] = domain->edges[0][c0 + 1] - domain->edges[0][c0] + 2 * width[0];
+    start[1] = edges1[c1] - width[1];
+    size[1] = edges1[c1 + 1] - edges1[c1] + 2 * width[1];
+}
+
+static struct PMDomainRoute *
+_route_create(PMHalo * halo, PMDomain * domain)
+{
+    PM * pm = domain->pm;
+    PMRegion * region = &halo->pm.IRegion;
+    struct PMDomainRoute * route = malloc(sizeof(route[0]));
+    ptrdiff_t i, j;
+    int r;
+
+    route->sendcounts = calloc(pm->NTask, sizeof(int));
+    route->sdispls = calloc(pm->NTask, sizeof(int));
+    route->recvcounts = calloc(pm->NTask, sizeof(int));
+    route->rdispls = calloc(pm->NTask, sizeof(int));
+
+    /* every row of the patch goes to the pencil that owns it */
+    int * owner = malloc(sizeof(int) * region->size[0] * region->size[1]);
+    for(i = 0; i < region->size[0]; i ++) {
+        int c0 = pm->Grid.MeshtoCart[0][_wrap(region->start[0] + i, pm->Nmesh[0])];
+        for(j = 0; j < region->size[1]; j ++) {
+            int c1 = pm->Grid.MeshtoCart[1][_wrap(region->start[1] + j, pm->Nmesh[1])];
+            r = c0 * pm->Nproc[1] + c1;
+            owner[i * region->size[1] + j] = r;
+            route->sendcounts[r] ++;
+        }
+    }
+    route->nsend = cumsum(route->sdispls, route->sendcounts, pm->NTask);
+    route->sendrow = malloc(sizeof(ptrdiff_t) * route->nsend);
+
+    int * offset = malloc(sizeof(int) * pm->NTask);
+    memcpy(offset, route->sdispls, sizeof(int) * pm->NTask);
+    for(i = 0; i < region->size[0]; i ++) {
+        for(j = 0; j < region->size[1]; j ++) {
+            r = owner[i * region->size[1] + j];
+            route->sendrow[offset[r]++] = i * region->strides[0] + j * region->strides[1];
+        }
+    }
+    free(offset);
+    free(owner);
+
+    /* the rows of the local mesh in the patch of every rank, in the same order as the patch sends them.
+     * the local region is a box, so the count is the product of the counts along the two axes. */
+    int c[2];
+    c[0] = pm->Grid.MeshtoCart[0][pm->IRegion.start[0]];
+    c[1] = pm->Grid.MeshtoCart[1][pm->IRegion.start[1]];
+
+    for(r = 0; r < pm->NTask; r ++) {
+        ptrdiff_t start[2], size[2];
+        _patch_box(domain, r, halo->width, start, size);
+        int n[2] = {0, 0};
+        int d;
+        for(d = 0; d < 2; d ++) {
+            for(i = 0; i < size[d]; i ++) {
+                if(pm->Grid.MeshtoCart[d][_wrap(start[d] + i, pm->Nmesh[d])] == c[d]) n[d] ++;
+            }
+        }
+        route->recvcounts[r] = n[0] * n[1];
+    }
+    route->nrecv = cumsum(route->rdispls, route->recvcounts, pm->NTask);
+    route->recvrow = malloc(sizeof(ptrdiff_t) * route->nrecv);
+
+    ptrdiff_t k = 0;
+    for(r = 0; r < pm->NTask; r ++) {
+        if(route->recvcounts[r] == 0) continue;
+        ptrdiff_t start[2], size[2];
+        _patch_box(domain, r, halo->width, start, size);
+        for(i = 0; i < size[0]; i ++) {
+            ptrdiff_t gi = _wrap(start[0] + i, pm->Nmesh[0]);
+            if(pm->Grid.MeshtoCart[0][gi] != c[0]) continue;
+            for(j = 0; j < size[1]; j ++) {
+                ptrdiff_t gj = _wrap(start[1] + j, pm->Nmesh[1]);
+                if(pm->Grid.MeshtoCart[1][gj] != c[1]) continue;
+                route->recvrow[k++] = (gi - pm->IRegion.start[0]) * pm->IRegion.strides[0]
+                                    + (gj - pm->IRegion.start[1]) * pm->IRegion.strides[1];
+            }
+        }
+    }
+    return route;
+}
+
+void
+pm_domain_route_free(struct PMDomainRoute * route)
+{
+    free(route->recvrow);
+    free(route->sendrow);
+    free(route->rdispls);
+    free(route->recvcounts);
+    free(route->sdispls);
+    free(route->sendcounts);
+    free(route);
+}
+
+void
+pm_domain_halo_init(PMHalo * halo, PMDomain * domain, int width)
+{
+    PM * pm = domain->pm;
+
+    if(width > domain->width) {
+        fastpm_raise(-1, "The domains are balanced for a halo of %d cells, asking for %d.\n", domain->width, width);
+    }
+
+    halo->base = pm;
+    halo->pm = *pm;
+    /* never shares the cached objects of the base pm */
+    halo->pm.GhostPlan = NULL;
+    halo->pm.Domain = NULL;
+
+    int d;
+    for(d = 0; d < 2; d ++) {
+        halo->width[d] = (pm->Nproc[d] > 1) ? width : 0;
+    }
+
+    PMRegion * region = &halo->pm.IRegion;
+    _patch_box(domain, pm->ThisTask, halo->width, region->start, region->size);
+
+    /* the patch is not padded */
+    region->strides[2] = 1;
+    region->strides[1] = region->size[2];
+    region->strides[0] = region->size[1] * region->strides[1];
+    region->total = region->size[0] * region->strides[0];
+    halo->pm.allocsize = region->total;
+
+    halo->route = _route_create(halo, domain);
+}
+
+/* Move rows of nrow cells between the patches and the local meshes. The
+ * rows are added to the destination with reduce, copied otherwise. */
+static void
+_route_exchange(PMHalo * halo,
+        FastPMFloat * from, ptrdiff_t * fromrow, int * sendcounts, int * sdispls, size_t nsend,
+        FastPMFloat * to, ptrdiff_t * torow, int * recvcounts, int * rdispls, size_t nrecv,
+        int reduce)
+{
+    PM * pm = halo->base;
+    ptrdiff_t nrow = pm->IRegion.size[2];
+
+    FastPMFloat * sendbuf = fastpm_memory_alloc(pm->mem, sizeof(FastPMFloat) * nrow * nsend, FASTPM_MEMORY_STACK);
+    FastPMFloat * recvbuf = fastpm_memory_alloc(pm->mem, sizeof(FastPMFloat) * nrow * nrecv, FASTPM_MEMORY_STACK);
+
+    ptrdiff_t k;
+#pragma omp parallel for
+    for(k = 0; k < nsend; k ++) {
+        memcpy(sendbuf + k * nrow, from + fromrow[k], sizeof(FastPMFloat) * nrow);
+    }
+
+    MPI_Datatype ROW_TYPE;
+    MPI_Type_contiguous(sizeof(FastPMFloat) * nrow, MPI_BYTE, &ROW_TYPE);
+    MPI_Type_commit(&ROW_TYPE);
+    MPI_Alltoallv_sparse(sendbuf, sendcounts, sdispls, ROW_TYPE,
+                         recvbuf, recvcounts, rdispls, ROW_TYPE,
+                         pm->Comm2D);
+    MPI_Type_free(&ROW_TYPE);
+
+    if(!reduce) {
+#pragma omp parallel for
+        for(k = 0; k < nrecv; k ++) {
+            memcpy(to + torow[k], recvbuf + k * nrow, sizeof(FastPMFloat) * nrow);
+        }
+    } else {
+        /* the patches of several ranks overlap; the sources are added in order,
+         * and a patch holds every row at most once. */
+#pragma omp parallel
+        {
+            int r;
+            for(r = 0; r < pm->NTask; r ++) {
+                ptrdiff_t l;
+#pragma omp for
+                for(l = rdispls[r]; l < rdispls[r] + recvcounts[r]; l ++) {
+                    FastPMFloat * dst = to + torow[l];
+                    FastPMFloat * src = recvbuf + l * nrow;
+                    ptrdiff_t m;
+                    for(m = 0; m < nrow; m ++) {
+                        dst[m] += src[m];
+                    }
+                }
+            }
+        }
+    }
+
+    fastpm_memory_free(pm->mem, recvbuf);
+    fastpm_memory_free(pm->mem, sendbuf);
+}
+
+/* Add the rows of the patch from onto the local mesh to. */
+void
+pm_domain_route_reduce(PMHalo * halo, FastPMFloat * from, FastPMFloat * to)
+{
+    struct PMDomainRoute * route = halo->route;
+
+    /* as if painted on the local mesh; the padding is cleared */
+    memset(to, 0, sizeof(to[0]) * halo->base->allocsize);
+
+    _route_exchange(halo,
+        from, route->sendrow, route->sendcounts, route->sdispls, route->nsend,
+        to, route->recvrow, route->recvcounts, route->rdispls, route->nrecv,
+        1);
+}
+
+/* Fill the patch to with the rows of the local meshes from. */
+void
+pm_domain_route_fill(PMHalo * halo, FastPMFloat * from, FastPMFloat * to)
+{
+    struct PMDomainRoute * route = halo->route;
+
+    _route_exchange(halo,
+        from, route->recvrow, route->recvcounts, route->rdispls, route->nrecv,
+        to, route->sendrow, route->sendcounts, route->sdispls, route->nsend,
+        0);
+}
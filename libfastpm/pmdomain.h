@@ -0,0 +1,50 @@
+/* Particle domains balanced by the number of particles, decoupled from the
+ * pencils of the mesh.
+ *
+ * The domains are boxes of mesh cells along the first two axes, on the same
+ * Nproc[0] x Nproc[1] grid of ranks as the pencils: the first axis is cut into
+ * Nproc[0] slabs of about equal counts, and each slab is cut along the second
+ * axis into Nproc[1] domains of about equal counts.
+ *
+ * The particles are painted into a patch around the local domain, a PMHalo
+ * created by pm_domain_halo_init. pm_halo_reduce routes the rows of the patch
+ * to the pencils that own them, and pm_halo_fill routes the rows of the force
+ * meshes back to the patches for the readout.
+ * */
+typedef struct PMDomain {
+    PM * pm;
+    int width; /* the patches may extend the domains by up to width cells */
+    /* edges[0][c0] for the slabs; edges[1][c0 * (Nproc[1] + 1) + c1] for the domains in slab c0 */
+    ptrdiff_t * edges[2];
+    /* MeshtoCart[0][i] is the slab of cell i; MeshtoCart[1][c0 * Nmesh[1] + j] the domain of cell j in slab c0 */
+    int * MeshtoCart[2];
+} PMDomain;
+
+/* Cut the domains of pm->Domain (created on first use) such that each holds
+ * about the same number of the particles in p. */
+void
+pm_domain_balance(PM * pm, FastPMStore * p, int width);
+
+void
+pm_domain_free(PMDomain * domain);
+
+int
+pm_domain_pos_to_rank(PMDomain * domain, double pos[3]);
+
+int
+FastPMTargetDomain(FastPMStore * p, ptrdiff_t i, PMDomain * domain);
+
+/* A halo of width cells around the local domain, which is routed to the pencils of domain->pm;
+ * free with pm_halo_destroy. */
+void
+pm_domain_halo_init(PMHalo * halo, PMDomain * domain, int width);
+
+/* used by pm_halo_reduce and pm_halo_fill */
+void
+pm_domain_route_reduce(PMHalo * halo, FastPMFloat * from, FastPMFloat * to);
+
+void
+pm_domain_route_fill(PMHalo * halo, FastPMFloat * from, FastPMFloat * to);
+
+void
+pm_domain_route_free(struct PMDomainRoute * route);
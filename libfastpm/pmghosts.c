@@ -1,13 +1,169 @@
 #include <string.h>
 #include <math.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <fastpm/libfastpm.h>
 #include <fastpm/logging.h>
 #include "pmpfft.h"
 #include "pmghosts.h"
 
+static ptrdiff_t
+_ghost_margin(double Below[3], double Above[3], int d)
+{
+    return ceil(fmax(-Below[d], Above[d]));
+}
+
+static PMGhostPlan *
+pm_ghosts_plan_create(PM * pm, double Below[3], double Above[3])
+{
+    PMGhostPlan * plan = malloc(sizeof(plan[0]));
+
+    /* Mark the process grid coordinates touched by the local region
+     * extended by the margin on both sides; the neighbour relation is then
+     * symmetric, and the sources of the graph are the same as the destinations. */
+    char * cart[2];
+    int d;
+    for(d = 0; d < 2; d ++) {
+        plan->margin[d] = _ghost_margin(Below, Above, d);
+        cart[d] = calloc(pm->Nproc[d], 1);
+        ptrdiff_t i;
+        ptrdiff_t n = pm->IRegion.size[d] + 2 * plan->margin[d];
+        if(n > pm->Nmesh[d]) n = pm->Nmesh[d];
+        for(i = 0; i < n; i ++) {
+            ptrdiff_t ipos = pm->IRegion.start[d] - plan->margin[d] + i;
+            while(ipos < 0) ipos += pm->Nmesh[d];
+            while(ipos >= pm->Nmesh[d]) ipos -= pm->Nmesh[d];
+            cart[d][pm->Grid.MeshtoCart[d][ipos]] = 1;
+        }
+    }
+
+    plan->isneighbour = calloc(pm->NTask, 1);
+    plan->nneighbours = 0;
+    int c0, c1;
+    for(c0 = 0; c0 < pm->Nproc[0]; c0 ++) {
+        if(!cart[0][c0]) continue;
+        for(c1 = 0; c1 < pm->Nproc[1]; c1 ++) {
+            if(!cart[1][c1]) continue;
+            int rank = c0 * pm->Nproc[1] + c1;
+            if(rank == pm->ThisTask) continue;
+            plan->isneighbour[rank] = 1;
+            plan->nneighbours ++;
+        }
+    }
+    free(cart[1]);
+    free(cart[0]);
+
+    /* sorted by rank, such that the buffers ordered by rank are contiguous per neighbour */
+    plan->neighbours = malloc(sizeof(int) * (plan->nneighbours + 1));
+    int r, k = 0;
+    for(r = 0; r < pm->NTask; r ++) {
+        if(plan->isneighbour[r]) plan->neighbours[k++] = r;
+    }
+
+    /* unit weights rather than MPI_UNWEIGHTED, which some MPI headers declare
+     * as a zero-sized array that GCC then flags as overread. */
+    int * weights = malloc(sizeof(int) * (plan->nneighbours + 1));
+    for(k = 0; k < plan->nneighbours + 1; k ++) {
+        weights[k] = 1;
+    }
+    MPI_Dist_graph_create_adjacent(pm->Comm2D,
+            plan->nneighbours, plan->neighbours, weights,
+            plan->nneighbours, plan->neighbours, weights,
+            MPI_INFO_NULL, 0, &plan->comm);
+    free(weights);
+
+    plan->sendcounts = malloc(sizeof(int) * (plan->nneighbours + 1));
+    plan->sdispls = malloc(sizeof(int) * (plan->nneighbours + 1));
+    plan->recvcounts = malloc(sizeof(int) * (plan->nneighbours + 1));
+    plan->rdispls = malloc(sizeof(int) * (plan->nneighbours + 1));
+
+    plan->mem = pm->mem;
+    plan->buffer = NULL;
+    plan->buffersize = 0;
+    return plan;
+}
+
+void
+pm_ghosts_plan_free(PMGhostPlan * plan)
+{
+    if(plan->buffer)
+        fastpm_memory_free(plan->mem, plan->buffer);
+    free(plan->rdispls);
+    free(plan->recvcounts);
+    free(plan->sdispls);
+    free(plan->sendcounts);
+    MPI_Comm_free(&plan->comm);
+    free(plan->neighbours);
+    free(plan->isneighbour);
+    free(plan);
+}
+
+/* The cached plan of the PM for the probing margin (Below, Above); collective
+ * over pm->Comm2D. The plan is only rebuilt if the margin is wider than the one
+ * it was built for, e.g. the wider margin used for interlacing keeps a single plan. */
+PMGhostPlan *
+pm_ghosts_get_plan(PM * pm, double Below[3], double Above[3])
+{
+    PMGhostPlan * plan = pm->GhostPlan;
+    if(plan) {
+        int d;
+        int fits = 1;
+        for(d = 0; d < 2; d ++) {
+            if(_ghost_margin(Below, Above, d) > plan->margin[d]) fits = 0;
+        }
+        if(fits) return plan;
+        pm_ghosts_plan_free(plan);
+    }
+    pm->GhostPlan = pm_ghosts_plan_create(pm, Below, Above);
+    return pm->GhostPlan;
+}
+
+/* A buffer of at least size bytes; it is only valid till the next call. The
+ * buffer is held by the plan, on the heap of the memory of the PM. */
+static void *
+pm_ghosts_plan_buffer(PMGhostPlan * plan, size_t size)
+{
+    if(size > plan->buffersize) {
+        if(plan->buffer)
+            fastpm_memory_free(plan->mem, plan->buffer);
+        plan->buffer = fastpm_memory_alloc(plan->mem, size, FASTPM_MEMORY_HEAP);
+        fastpm_memory_tag(plan->mem, plan->buffer, "GhostPlanBuffer");
+        plan->buffersize = size;
+    }
+    return plan->buffer;
+}
+
+/* Exchange elements of elsize bytes with the neighbours of the plan; counts
+ * and displacements are indexed by the ranks in pm->Comm2D. */
+static void
+pm_ghosts_exchange(PMGhostData * pgd,
+    void * sendbuf, int * sendcnts, int * sdispls,
+    void * recvbuf, int * recvcnts, int * rdispls,
+    size_t elsize)
+{
+    PMGhostPlan * plan = pgd->plan;
+    MPI_Datatype GHOST_TYPE;
+    MPI_Type_contiguous(elsize, MPI_BYTE, &GHOST_TYPE);
+    MPI_Type_commit(&GHOST_TYPE);
+    int k;
+    for(k = 0; k < plan->nneighbours; k ++) {
+        int r = plan->neighbours[k];
+        plan->sendcounts[k] = sendcnts[r];
+        plan->sdispls[k] = sdispls[r];
+        plan->recvcounts[k] = recvcnts[r];
+        plan->rdispls[k] = rdispls[r];
+    }
+    MPI_Neighbor_alltoallv(sendbuf, plan->sendcounts, plan->sdispls, GHOST_TYPE,
+                           recvbuf, plan->recvcounts, plan->rdispls, GHOST_TYPE,
+                           plan->comm);
+    MPI_Type_free(&GHOST_TYPE);
+}
+
 void pm_ghosts_free(PMGhostData * pgd) {
+    fastpm_store_destroy(pgd->ghosts);
     fastpm_memory_free(pgd->pm->mem, pgd->ighost_to_ipar);
     free(pgd->Nsend);
     free(pgd->Osend);
@@ -16,86 +172,153 @@ void pm_ghosts_free(PMGhostData * pgd) {
     free(pgd);
 }
 
+/* Iterate over the ghosts of all particles, in nchunks contiguous chunks of particles
+ * that are processed in parallel. ppd->Nsend of the iterator points to the counters of
+ * the chunk, ChunkNsend + ichunk * NTask. */
 static void pm_iter_ghosts(PM * pm, PMGhostData * pgd, 
-    pm_iter_ghosts_func iter_func) {
+    pm_iter_ghosts_func iter_func, int * ChunkNsend, int nchunks) {
+
+    /* a particle is not a ghost of any other rank if all probed cells are local */
+    int lower[2], upper[2];
+    int d;
+    for(d = 0; d < 2; d ++) {
+        lower[d] = pm->IRegion.start[d] - pgd->Below[d];
+        upper[d] = pm->IRegion.start[d] + pm->IRegion.size[d] - pgd->Above[d];
+    }
 
-    ptrdiff_t i;
-    for (i = 0; i < pgd->np; i ++) {
+    int ichunk;
+#pragma omp parallel for schedule(static, 1)
+    for(ichunk = 0; ichunk < nchunks; ichunk ++) {
+        ptrdiff_t start = ichunk * pgd->np / nchunks;
+        ptrdiff_t end = (ichunk + 1) * pgd->np / nchunks;
         PMGhostData localppd = *pgd;
-        double pos[3];
-        int rank;
-        pgd->get_position(pgd->p, i, pos);
-        int d;
-        int ipos[3];
-        for(d = 0; d < 3; d ++) {
-            ipos[d] = floor(pos[d] * pm->InvCellSize[d]);
-        }
+        localppd.Nsend = ChunkNsend + ichunk * pm->NTask;
 
-        /* probe neighbours */
-        ptrdiff_t j[3];
-        int ranks[1000];
-        int used = 0;
-        localppd.ipar = i;
-        for(j[2] = pm->Below[2]; j[2] <= pm->Above[2]; j[2] ++)
-        for(j[0] = pm->Below[0]; j[0] <= pm->Above[0]; j[0] ++)
-        for(j[1] = pm->Below[1]; j[1] <= pm->Above[1]; j[1] ++) {
-            int npos[3];
+        ptrdiff_t i;
+        for (i = start; i < end; i ++) {
+            double pos[3];
+            int rank;
+            pgd->get_position(pgd->p, i, pos);
             int d;
+            int ipos[3];
             for(d = 0; d < 3; d ++) {
-                npos[d] = ipos[d] + j[d];
+                ipos[d] = floor(pos[d] * pm->InvCellSize[d]);
+            }
+
+            if(LIKELY(ipos[0] >= lower[0] && ipos[0] < upper[0]
+                   && ipos[1] >= lower[1] && ipos[1] < upper[1])) {
+                continue;
+            }
+
+            /* probe neighbours */
+            ptrdiff_t j[3];
+            int ranks[1000];
+            int used = 0;
+            localppd.ipar = i;
+            for(j[2] = pgd->Below[2]; j[2] <= pgd->Above[2]; j[2] ++)
+            for(j[0] = pgd->Below[0]; j[0] <= pgd->Above[0]; j[0] ++)
+            for(j[1] = pgd->Below[1]; j[1] <= pgd->Above[1]; j[1] ++) {
+                int npos[3];
+                int d;
+                for(d = 0; d < 3; d ++) {
+                    npos[d] = ipos[d] + j[d];
+                }
+                rank = pm_ipos_to_rank(pm, npos);
+                if(LIKELY(rank == pm->ThisTask))  continue;
+                int ptr;
+                for(ptr = 0; ptr < used; ptr++) {
+                    if(rank == ranks[ptr]) break;
+                } 
+                if(UNLIKELY(ptr == used)) {
+                    ranks[used++] = rank;
+                    localppd.rank = rank;
+                    localppd.reason = j;
+                    iter_func(pm, &localppd);
+                } 
             }
-            rank = pm_ipos_to_rank(pm, npos);
-            if(LIKELY(rank == pm->ThisTask))  continue;
-            int ptr;
-            for(ptr = 0; ptr < used; ptr++) {
-                if(rank == ranks[ptr]) break;
-            } 
-            if(UNLIKELY(ptr == used)) {
-                ranks[used++] = rank;
-                localppd.rank = rank;
-                localppd.reason = j;
-                iter_func(pm, &localppd);
-            } 
         }
     }
 }
 
 static void count_ghosts(PM * pm, PMGhostData * pgd) {
-//#pragma omp atomic
     pgd->Nsend[pgd->rank] ++;
 }
 
 static void build_ghost_buffer(PM * pm, PMGhostData * pgd) {
     FastPMStore * p = pgd->p;
-    double pos[3];
-    pgd->get_position(pgd->p, pgd->ipar, pos);
 
     int ighost;
     int offset; 
 
-//#pragma omp atomic capture
+    /* offset of the ghost within the rank */
     offset = pgd->Nsend[pgd->rank] ++;
 
     ighost = pgd->Osend[pgd->rank] + offset;
 
-    p->pack(p, pgd->ipar,
-        (char*) pgd->send_buffer + ighost * pgd->elsize, pgd->attributes);
+    /* the position as seen by the painter, followed by the other attributes */
+    char * buf = (char*) pgd->send_buffer + ighost * pgd->elsize;
+    double pos[3];
+    pgd->get_position(p, pgd->ipar, pos);
+    memcpy(buf, pos, sizeof(pos));
+
+    p->pack(p, pgd->ipar, buf + sizeof(pos), pgd->attributes & ~PACK_POS);
 
     pgd->ighost_to_ipar[ighost] = pgd->ipar;
 }
 
+/* the columns of a store holding the attributes */
+static enum FastPMPackFields
+_ghost_columns(enum FastPMPackFields attributes)
+{
+    static const struct {
+        enum FastPMPackFields components;
+        enum FastPMPackFields column;
+    } vectors[] = {
+        {PACK_POS_X | PACK_POS_Y | PACK_POS_Z, PACK_POS},
+        {PACK_ACC_X | PACK_ACC_Y | PACK_ACC_Z, PACK_ACC},
+        {PACK_DX1_X | PACK_DX1_Y | PACK_DX1_Z, PACK_DX1},
+        {PACK_DX2_X | PACK_DX2_Y | PACK_DX2_Z, PACK_DX2},
+        {PACK_TIDAL_XX | PACK_TIDAL_YY | PACK_TIDAL_ZZ
+       | PACK_TIDAL_XY | PACK_TIDAL_YZ | PACK_TIDAL_ZX, PACK_TIDAL},
+    };
+    enum FastPMPackFields columns = PACK_POS;
+    int i;
+    for(i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i ++) {
+        if(attributes & vectors[i].components) {
+            columns |= vectors[i].column;
+        }
+        attributes &= ~vectors[i].components;
+    }
+    return columns | attributes;
+}
+
 PMGhostData *
 pm_ghosts_create(PM * pm, FastPMStore *p,
     enum FastPMPackFields attributes,
+    enum FastPMPackFields readout,
     fastpm_posfunc get_position)
 {
+    return pm_ghosts_create_extra(pm, p, attributes, readout, get_position, 0);
+}
+
+PMGhostData *
+pm_ghosts_create_extra(PM * pm, FastPMStore *p,
+    enum FastPMPackFields attributes,
+    enum FastPMPackFields readout,
+    fastpm_posfunc get_position,
+    int extra)
+{
 
     PMGhostData * pgd = malloc(sizeof(pgd[0]));
     pgd->pm = pm;
+    int d;
+    for(d = 0; d < 3; d ++) {
+        pgd->Below[d] = pm->Below[d];
+        pgd->Above[d] = pm->Above[d] + extra;
+    }
     pgd->p = p;
     pgd->np = p->np;
-    pgd->np_upper = p->np_upper;
-    pgd->attributes = attributes;
+    pgd->attributes = attributes | PACK_POS;
     if(get_position == NULL)
         pgd->get_position = p->get_position;
     else
@@ -105,7 +328,7 @@ pm_ghosts_create(PM * pm, FastPMStore *p,
     ptrdiff_t i;
     size_t Nsend;
     size_t Nrecv;
-    size_t elsize = p->pack(pgd->p, 0, NULL, pgd->attributes);
+    size_t elsize = sizeof(double) * 3 + p->pack(pgd->p, 0, NULL, pgd->attributes & ~PACK_POS);
 
     pgd->Nsend = calloc(pm->NTask, sizeof(int));
     pgd->Osend = calloc(pm->NTask, sizeof(int));
@@ -114,49 +337,85 @@ pm_ghosts_create(PM * pm, FastPMStore *p,
 
     pgd->elsize = elsize;
 
-    memset(pgd->Nsend, 0, sizeof(pgd->Nsend[0]) * pm->NTask);
-
-    pm_iter_ghosts(pm, pgd, count_ghosts);
+    /* Ghosts are counted per chunk of particles; the prefix sum over
+     * chunks gives each chunk its offsets into the send buffer. The ghosts
+     * are ordered the same way as if they were discovered serially. */
+#ifdef _OPENMP
+    int nchunks = omp_get_max_threads();
+#else
+    int nchunks = 1;
+#endif
+    int * ChunkNsend = calloc(nchunks * pm->NTask, sizeof(int));
+
+    pm_iter_ghosts(pm, pgd, count_ghosts, ChunkNsend, nchunks);
+
+    int r, c;
+    for(r = 0; r < pm->NTask; r ++) {
+        int running = 0;
+        for(c = 0; c < nchunks; c ++) {
+            int n = ChunkNsend[c * pm->NTask + r];
+            ChunkNsend[c * pm->NTask + r] = running;
+            running += n;
+        }
+        pgd->Nsend[r] = running;
+    }
 
     Nsend = cumsum(pgd->Osend, pgd->Nsend, pm->NTask);
 
-    MPI_Alltoall(pgd->Nsend, 1, MPI_INT, pgd->Nrecv, 1, MPI_INT, pm->Comm2D);
+    /* The plan connects the ranks within the ghost margin of the local region;
+     * the ghosts of a store decomposed on pm never go further. */
+    PMGhostPlan * plan = pm_ghosts_get_plan(pm, pgd->Below, pgd->Above);
+    for(r = 0; r < pm->NTask; r ++) {
+        if(pgd->Nsend[r] > 0 && !plan->isneighbour[r]) {
+            fastpm_raise(-1, "%d ghosts go to rank %d, beyond the ghost margin of rank %d. "
+                             "The particles are not decomposed on this PM.\n",
+                             pgd->Nsend[r], r, pm->ThisTask);
+        }
+    }
+    pgd->plan = plan;
+
+    int k;
+    for(k = 0; k < plan->nneighbours; k ++) {
+        plan->sendcounts[k] = pgd->Nsend[plan->neighbours[k]];
+    }
+    MPI_Neighbor_alltoall(plan->sendcounts, 1, MPI_INT,
+                          plan->recvcounts, 1, MPI_INT, plan->comm);
+    for(k = 0; k < plan->nneighbours; k ++) {
+        pgd->Nrecv[plan->neighbours[k]] = plan->recvcounts[k];
+    }
 
     Nrecv = cumsum(pgd->Orecv, pgd->Nrecv, pm->NTask);
-    
 
     pgd->ighost_to_ipar = fastpm_memory_alloc(pm->mem, Nsend * sizeof(int), FASTPM_MEMORY_HEAP);
-    pgd->send_buffer = fastpm_memory_alloc(pm->mem, Nsend * pgd->elsize, FASTPM_MEMORY_HEAP);
-    pgd->recv_buffer = fastpm_memory_alloc(pm->mem, Nrecv * pgd->elsize, FASTPM_MEMORY_HEAP);
 
-    memset(pgd->Nsend, 0, sizeof(pgd->Nsend[0]) * pm->NTask);
+    /* only the exchanged attributes and those read out to the ghosts are allocated */
+    fastpm_store_init(pgd->ghosts, Nrecv, _ghost_columns(pgd->attributes | readout), FASTPM_MEMORY_HEAP);
+    pgd->ghosts->np = Nrecv;
+
+    pgd->send_buffer = pm_ghosts_plan_buffer(plan, (Nsend + Nrecv) * pgd->elsize);
+    pgd->recv_buffer = (char*) pgd->send_buffer + Nsend * pgd->elsize;
 
-    pm_iter_ghosts(pm, pgd, build_ghost_buffer);
+    pm_iter_ghosts(pm, pgd, build_ghost_buffer, ChunkNsend, nchunks);
+
+    free(ChunkNsend);
 
     /* exchange */
 
     pgd->nghosts = Nrecv;
 
-    if(Nrecv + pgd->np > pgd->np_upper) {
-        fastpm_raise(-1, "Too many ghosts; asking for %td, space for %td\n", Nrecv, pgd->np_upper - pgd->np);
-    }
-
-    MPI_Datatype GHOST_TYPE;
-    MPI_Type_contiguous(pgd->elsize, MPI_BYTE, &GHOST_TYPE);
-    MPI_Type_commit(&GHOST_TYPE);
-    MPI_Alltoallv_sparse(pgd->send_buffer, pgd->Nsend, pgd->Osend, GHOST_TYPE,
-                  pgd->recv_buffer, pgd->Nrecv, pgd->Orecv, GHOST_TYPE,
-                    pm->Comm2D);
-    MPI_Type_free(&GHOST_TYPE);
+    pm_ghosts_exchange(pgd, pgd->send_buffer, pgd->Nsend, pgd->Osend,
+                            pgd->recv_buffer, pgd->Nrecv, pgd->Orecv, pgd->elsize);
 
+    FastPMStore * ghosts = pgd->ghosts;
 #pragma omp parallel for
     for(i = 0; i < Nrecv; i ++) {
-        p->unpack(pgd->p, pgd->np + i,
-                (char*) pgd->recv_buffer + i * pgd->elsize,
-                        pgd->attributes);
+        char * buf = (char*) pgd->recv_buffer + i * pgd->elsize;
+        memcpy(ghosts->x[i], buf, sizeof(ghosts->x[0]));
+        ghosts->unpack(ghosts, i, buf + sizeof(ghosts->x[0]),
+                        pgd->attributes & ~PACK_POS);
     }
-    fastpm_memory_free(pm->mem, pgd->recv_buffer);
-    fastpm_memory_free(pm->mem, pgd->send_buffer);
+    pgd->send_buffer = NULL;
+    pgd->recv_buffer = NULL;
 
     return pgd;
 }
@@ -170,33 +429,38 @@ void pm_ghosts_reduce(PMGhostData * pgd, enum FastPMPackFields attributes) {
     ptrdiff_t i;
 
     pgd->elsize = p->pack(pgd->p, 0, NULL, attributes);
-    pgd->recv_buffer = fastpm_memory_alloc(pm->mem, Nrecv * pgd->elsize, FASTPM_MEMORY_HEAP);
-    pgd->send_buffer = fastpm_memory_alloc(pm->mem, Nsend * pgd->elsize, FASTPM_MEMORY_HEAP);
+    pgd->recv_buffer = pm_ghosts_plan_buffer(pgd->plan, (Nsend + Nrecv) * pgd->elsize);
+    pgd->send_buffer = (char*) pgd->recv_buffer + Nrecv * pgd->elsize;
     pgd->ReductionAttributes = attributes;
 
 #pragma omp parallel for
     for(i = 0; i < pgd->nghosts; i ++) {
-        p->pack(p, i + pgd->np,
+        pgd->ghosts->pack(pgd->ghosts, i,
             (char*) pgd->recv_buffer + i * pgd->elsize, 
             pgd->ReductionAttributes);
     }
 
-    MPI_Datatype GHOST_TYPE;
-    MPI_Type_contiguous(pgd->elsize, MPI_BYTE, &GHOST_TYPE);
-    MPI_Type_commit(&GHOST_TYPE);
-    MPI_Alltoallv_sparse(pgd->recv_buffer, pgd->Nrecv, pgd->Orecv, GHOST_TYPE,
-                  pgd->send_buffer, pgd->Nsend, pgd->Osend, GHOST_TYPE,
-                    pm->Comm2D);
-    MPI_Type_free(&GHOST_TYPE);
-
-    /* now reduce the attributes. */
-    int ighost;
-#pragma omp parallel for
-    for(ighost = 0; ighost < Nsend; ighost ++) {
-        p->reduce(p, pgd->ighost_to_ipar[ighost],
-            (char*) pgd->send_buffer + ighost * pgd->elsize,
-            pgd->ReductionAttributes);
+    pm_ghosts_exchange(pgd, pgd->recv_buffer, pgd->Nrecv, pgd->Orecv,
+                            pgd->send_buffer, pgd->Nsend, pgd->Osend, pgd->elsize);
+
+    /* now reduce the attributes. A particle has at most one ghost per rank,
+     * so the ghosts returned by one rank never conflict; the ranks are
+     * reduced one after another, giving the same sums for any number of threads. */
+#pragma omp parallel
+    {
+        int r;
+        for(r = 0; r < pm->NTask; r ++) {
+            if(pgd->Nsend[r] == 0) continue;
+            int j;
+#pragma omp for
+            for(j = 0; j < pgd->Nsend[r]; j ++) {
+                int ighost = pgd->Osend[r] + j;
+                p->reduce(p, pgd->ighost_to_ipar[ighost],
+                    (char*) pgd->send_buffer + ighost * pgd->elsize,
+                    pgd->ReductionAttributes);
+            }
+        }
     }
-    fastpm_memory_free(pm->mem, pgd->send_buffer);
-    fastpm_memory_free(pm->mem, pgd->recv_buffer);
+    pgd->send_buffer = NULL;
+    pgd->recv_buffer = NULL;
 }
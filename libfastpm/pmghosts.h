@@ -1,11 +1,40 @@
+/* The neighbour pattern of the ghost exchange. Ghosts of a particle in the
+ * local region can only go to the ranks whose domains are within the probing
+ * margin of the ghosts; these are connected by a distributed graph
+ * communicator, such that counts and ghosts are exchanged with neighbour
+ * collectives. The plan is cached on the PM and rebuilt if the margin grows. */
+typedef struct PMGhostPlan {
+    ptrdiff_t margin[2];
+
+    MPI_Comm comm;      /* distributed graph of the neighbours, in the rank order of Comm2D */
+    int nneighbours;
+    int * neighbours;   /* sorted ranks of the neighbours in Comm2D */
+    char * isneighbour; /* NTask flags */
+
+    /* per neighbour counts and displacements */
+    int * sendcounts;
+    int * sdispls;
+    int * recvcounts;
+    int * rdispls;
+
+    /* exchange buffer recycled across calls, on the heap of mem */
+    FastPMMemory * mem;
+    void * buffer;
+    size_t buffersize;
+} PMGhostPlan;
+
 typedef struct PMGhostData {
     PM * pm;
     FastPMStore * p;
+    /* the ghosts of other ranks, in a store of their own; ghosts->x is
+     * the position given by get_position on the rank of the particle. */
+    FastPMStore ghosts[1];
     size_t np;
-    size_t np_upper;
     size_t nghosts;
     enum FastPMPackFields attributes;
     fastpm_posfunc get_position;
+    double Below[3]; /* the probing margin of the ghosts, in cells */
+    double Above[3];
 
     /* private members */
     int * Nsend;
@@ -14,6 +43,7 @@ typedef struct PMGhostData {
     int * Orecv;
     void * send_buffer;
     void * recv_buffer;
+    PMGhostPlan * plan;
 
     /* iterator status */
     ptrdiff_t ipar;
@@ -26,9 +56,35 @@ typedef struct PMGhostData {
 
 typedef void (*pm_iter_ghosts_func)(PM * pm, PMGhostData * ppd);
 
+/* Create the ghosts of the particles in p. The position and the attributes are sent
+ * to the ghosts; the ghost store also holds the columns of readout, which
+ * are read out to the ghosts and reduced with pm_ghosts_reduce.
+ * p must be decomposed on pm (e.g. with fastpm_store_decompose_pm); raises
+ * if a ghost goes beyond the neighbours of the plan. */
 PMGhostData * 
-pm_ghosts_create(PM * pm, FastPMStore * p, enum FastPMPackFields attributes, fastpm_posfunc get_position);
+pm_ghosts_create(PM * pm, FastPMStore * p, enum FastPMPackFields attributes,
+    enum FastPMPackFields readout, fastpm_posfunc get_position);
 
+/* As pm_ghosts_create, but the ghosts reach extra cells further above the
+ * margin of pm (pm->Below, pm->Above), e.g. for a painter with a positive offset. */
+PMGhostData *
+pm_ghosts_create_extra(PM * pm, FastPMStore * p, enum FastPMPackFields attributes,
+    enum FastPMPackFields readout, fastpm_posfunc get_position, int extra);
+
+/* Add the attributes of the ghosts back to the owning particles. Several
+ * attributes can be or-ed together; they are then exchanged in one round. */
 void pm_ghosts_reduce(PMGhostData * pgd, enum FastPMPackFields attributes);
 void pm_ghosts_free(PMGhostData * pgd);
 
+/* paint / read out the particles and their ghosts; implemented in painter.c */
+void
+pm_ghosts_paint(PMGhostData * pgd, FastPMPainter * painter, FastPMFloat * canvas,
+    enum FastPMPackFields attribute);
+
+void
+pm_ghosts_readout_multi(PMGhostData * pgd, FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+    enum FastPMPackFields * attributes);
+
+PMGhostPlan * pm_ghosts_get_plan(PM * pm, double Below[3], double Above[3]);
+void pm_ghosts_plan_free(PMGhostPlan * plan);
+
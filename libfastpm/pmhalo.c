@@ -0,0 +1,351 @@
+#include <string.h>
+#include <mpi.h>
+
+#include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
+#include "pmpfft.h"
+#include "pmhalo.h"
+#include "pmdomain.h"
+
+void
+pm_halo_init(PMHalo * halo, PM * pm, int width)
+{
+    halo->base = pm;
+    halo->pm = *pm;
+    /* never shares the cached objects of the base pm */
+    halo->pm.GhostPlan = NULL;
+    halo->pm.Domain = NULL;
+    halo->route = NULL;
+
+    PMRegion * region = &halo->pm.IRegion;
+    int d;
+    for(d = 0; d < 2; d ++) {
+        halo->width[d] = (pm->Nproc[d] > 1) ? width : 0;
+        if(halo->width[d] == 0) continue;
+
+        /* the halo shall only reach the adjacent ranks */
+        int j;
+        for(j = 0; j < pm->Nproc[d]; j ++) {
+            ptrdiff_t size = pm->Grid.edges_int[d][j + 1] - pm->Grid.edges_int[d][j];
+            if(size < width) {
+                fastpm_raise(-1, "A mesh halo of %d cells is wider than the local mesh of %td cells along axis %d.\n", width, size, d);
+            }
+        }
+        region->start[d] -= halo->width[d];
+        region->size[d] += 2 * halo->width[d];
+    }
+    /* the extended mesh is not padded */
+    region->strides[2] = 1;
+    region->strides[1] = region->size[2];
+    region->strides[0] = region->size[1] * region->strides[1];
+    region->total = region->size[0] * region->strides[0];
+    halo->pm.allocsize = region->total;
+}
+
+void
+pm_halo_destroy(PMHalo * halo)
+{
+    if(halo->route) {
+        pm_domain_route_free(halo->route);
+        halo->route = NULL;
+    }
+}
+
+enum { HALO_PACK, HALO_UNPACK, HALO_ADD };
+
+/* copy between the box [lo0, hi0) x [lo1, hi1) x [0, size2) of the extended mesh and buf */
+static void
+_halo_box(PMHalo * halo, FastPMFloat * mesh, ptrdiff_t lo[2], ptrdiff_t hi[2], FastPMFloat * buf, int mode)
+{
+    PMRegion * region = &halo->pm.IRegion;
+    ptrdiff_t n1 = hi[1] - lo[1];
+    ptrdiff_t row = n1 * region->size[2];
+    ptrdiff_t i;
+
+#pragma omp parallel for
+    for(i = lo[0]; i < hi[0]; i ++) {
+        FastPMFloat * m = mesh + i * region->strides[0] + lo[1] * region->strides[1];
+        FastPMFloat * b = buf + (i - lo[0]) * row;
+        ptrdiff_t j;
+        switch(mode) {
+            case HALO_PACK:
+                memcpy(b, m, sizeof(b[0]) * row);
+            break;
+            case HALO_UNPACK:
+                memcpy(m, b, sizeof(b[0]) * row);
+            break;
+            case HALO_ADD:
+                for(j = 0; j < row; j ++) {
+                    m[j] += b[j];
+                }
+            break;
+        }
+    }
+}
+
+/* Exchange the halo along axis d with the adjacent ranks. With reduce, the
+ * halo cells are added onto the cells owned by the neighbours; otherwise the owned
+ * cells next to the edges are copied into the halo of the neighbours.
+ *
+ * The exchange along axis 0 spans the full extended range of axis 1 and the
+ * exchange along axis 1 only the owned range of axis 0; the reduction goes along
+ * axis 0 first and the fill along axis 1 first, such that the corners are carried over. */
+static void
+_halo_exchange(PMHalo * halo, FastPMFloat * mesh, int d, int reduce)
+{
+    PM * pm = halo->base;
+    PMRegion * region = &halo->pm.IRegion;
+    ptrdiff_t w = halo->width[d];
+
+    if(w == 0) return;
+
+    int e = 1 - d;
+    ptrdiff_t size = pm->IRegion.size[d];
+
+    /* the other axis */
+    ptrdiff_t elo = (d == 0) ? 0 : halo->width[e];
+    ptrdiff_t ehi = (d == 0) ? region->size[e] : halo->width[e] + pm->IRegion.size[e];
+
+    /* adjacent ranks along d */
+    int coord[2];
+    coord[0] = pm->Grid.MeshtoCart[0][pm->IRegion.start[0]];
+    coord[1] = pm->Grid.MeshtoCart[1][pm->IRegion.start[1]];
+
+    int cprev[2] = {coord[0], coord[1]};
+    int cnext[2] = {coord[0], coord[1]};
+    cprev[d] = (coord[d] + pm->Nproc[d] - 1) % pm->Nproc[d];
+    cnext[d] = (coord[d] + 1) % pm->Nproc[d];
+    int prev = cprev[0] * pm->Nproc[1] + cprev[1];
+    int next = cnext[0] * pm->Nproc[1] + cnext[1];
+
+    /* positions along d in the extended mesh; the owned cells are [w, w + size). */
+    ptrdiff_t lowerhalo = 0;
+    ptrdiff_t upperhalo = w + size;
+    ptrdiff_t lowerowned = w;
+    ptrdiff_t upperowned = size;
+
+    /* to prev, from next; to next, from prev */
+    ptrdiff_t sendto[2], recvto[2];
+    if(reduce) {
+        sendto[0] = lowerhalo;
+        recvto[0] = upperowned;
+        sendto[1] = upperhalo;
+        recvto[1] = lowerowned;
+    } else {
+        sendto[0] = lowerowned;
+        recvto[0] = upperhalo;
+        sendto[1] = upperowned;
+        recvto[1] = lowerhalo;
+    }
+
+    size_t count = w * (ehi - elo) * region->size[2];
+
+    FastPMFloat * sendbuf = fastpm_memory_alloc(pm->mem, sizeof(FastPMFloat) * count, FASTPM_MEMORY_STACK);
+    FastPMFloat * recvbuf = fastpm_memory_alloc(pm->mem, sizeof(FastPMFloat) * count, FASTPM_MEMORY_STACK);
+
+    MPI_Datatype HALO_TYPE;
+    MPI_Type_contiguous(sizeof(FastPMFloat), MPI_BYTE, &HALO_TYPE);
+    MPI_Type_commit(&HALO_TYPE);
+
+    int dir;
+    for(dir = 0; dir < 2; dir ++) {
+        int dest = (dir == 0) ? prev : next;
+        int source = (dir == 0) ? next : prev;
+        ptrdiff_t lo[2], hi[2];
+
+        lo[e] = elo;
+        hi[e] = ehi;
+
+        lo[d] = sendto[dir];
+        hi[d] = sendto[dir] + w;
+        _halo_box(halo, mesh, lo, hi, sendbuf, HALO_PACK);
+
+        MPI_Sendrecv(sendbuf, count, HALO_TYPE, dest, 1501 + dir,
+                     recvbuf, count, HALO_TYPE, source, 1501 + dir,
+                     pm->Comm2D, MPI_STATUS_IGNORE);
+
+        lo[d] = recvto[dir];
+        hi[d] = recvto[dir] + w;
+        _halo_box(halo, mesh, lo, hi, recvbuf, reduce ? HALO_ADD : HALO_UNPACK);
+    }
+
+    MPI_Type_free(&HALO_TYPE);
+
+    fastpm_memory_free(pm->mem, recvbuf);
+    fastpm_memory_free(pm->mem, sendbuf);
+}
+
+/* copy between the owned cells of the extended mesh and the (padded) local mesh */
+static void
+_halo_owned(PMHalo * halo, FastPMFloat * extended, FastPMFloat * local, int toextended)
+{
+    PM * pm = halo->base;
+    PMRegion * region = &halo->pm.IRegion;
+    ptrdiff_t i;
+
+#pragma omp parallel for
+    for(i = 0; i < pm->IRegion.size[0]; i ++) {
+        ptrdiff_t j;
+        for(j = 0; j < pm->IRegion.size[1]; j ++) {
+            FastPMFloat * e = extended + (i + halo->width[0]) * region->strides[0]
+                                       + (j + halo->width[1]) * region->strides[1];
+            FastPMFloat * l = local + i * pm->IRegion.strides[0] + j * pm->IRegion.strides[1];
+            if(toextended) {
+                memcpy(e, l, sizeof(l[0]) * pm->IRegion.size[2]);
+            } else {
+                memcpy(l, e, sizeof(l[0]) * pm->IRegion.size[2]);
+            }
+        }
+    }
+}
+
+/* Add the halo of the extended mesh from onto the owners; the owned cells are stored to the local mesh to.
+ * from is modified. */
+void
+pm_halo_reduce(PMHalo * halo, FastPMFloat * from, FastPMFloat * to)
+{
+    PM * pm = halo->base;
+
+    if(halo->route) {
+        pm_domain_route_reduce(halo, from, to);
+        return;
+    }
+
+    _halo_exchange(halo, from, 0, 1);
+    _halo_exchange(halo, from, 1, 1);
+
+    /* as if painted on the local mesh; the padding is cleared */
+    memset(to, 0, sizeof(to[0]) * pm->allocsize);
+    _halo_owned(halo, from, to, 0);
+}
+
+/* Fill the extended mesh to with the local mesh from and the cells of the neighbours in the halo. */
+void
+pm_halo_fill(PMHalo * halo, FastPMFloat * from, FastPMFloat * to)
+{
+    if(halo->route) {
+        pm_domain_route_fill(halo, from, to);
+        return;
+    }
+
+    _halo_owned(halo, to, from, 1);
+
+    _halo_exchange(halo, to, 1, 0);
+    _halo_exchange(halo, to, 0, 0);
+}
+
+/* Paint the local particles of p to canvas of halo->base, via the extended mesh. */
+void
+pm_halo_paint(PMHalo * halo, FastPMPainter * painter, FastPMFloat * canvas,
+    FastPMStore * p, fastpm_posfunc get_position, enum FastPMPackFields attribute)
+{
+    FastPMPainter hpainter[1];
+    *hpainter = *painter;
+    hpainter->pm = &halo->pm;
+
+    FastPMFloat * extended = pm_alloc(&halo->pm);
+
+    fastpm_paint_local(hpainter, extended, p, p->np, get_position, attribute);
+
+    pm_halo_reduce(halo, extended, canvas);
+
+    pm_free(&halo->pm, extended);
+}
+
+/* Read out ncanvas meshes of halo->base to the local particles of p. The meshes are
+ * filled and read out one at a time through a single extended mesh, such that only one
+ * extended mesh is held; the readout weights are not shared between the meshes. */
+void
+pm_halo_readout_multi(PMHalo * halo, FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+    FastPMStore * p, fastpm_posfunc get_position, enum FastPMPackFields * attributes)
+{
+    FastPMPainter hpainter[1];
+    *hpainter = *painter;
+    hpainter->pm = &halo->pm;
+
+    FastPMFloat * extended = pm_alloc(&halo->pm);
+    int c;
+    for(c = 0; c < ncanvas; c ++) {
+        pm_halo_fill(halo, canvas[c], extended);
+        fastpm_readout_local_multi(hpainter, &extended, 1, p, p->np, get_position, &attributes[c]);
+    }
+
+    pm_free(&halo->pm, extended);
+}
+
+/* Store to the local mesh of the base pm the central difference of npoints (4 or 6) points
+ * along dir of from, a mesh of halo->pm that is filled by pm_halo_fill; with dir < 0 the
+ * local region of from is copied. The width of the halo shall be at least npoints / 2. */
+void
+pm_halo_gradient(PMHalo * halo, FastPMFloat * from, FastPMFloat * to, int dir, int npoints)
+{
+    static const double c4[] = {8 / 12., -1 / 12.};
+    static const double c6[] = {45 / 60., -9 / 60., 1 / 60.};
+
+    if(npoints != 4 && npoints != 6) {
+        fastpm_raise(-1, "Unsupported number of points of the central difference: %d\n", npoints);
+    }
+
+    PM * pm = halo->base;
+    PMRegion * region = &halo->pm.IRegion;
+    const double * coeff = (npoints == 6) ? c6 : c4;
+    int nc = npoints / 2;
+
+    double InvCellSize = (dir >= 0) ? pm->InvCellSize[dir] : 1;
+
+    ptrdiff_t i;
+#pragma omp parallel for
+    for(i = 0; i < pm->IRegion.size[0]; i ++) {
+        ptrdiff_t j;
+        for(j = 0; j < pm->IRegion.size[1]; j ++) {
+            ptrdiff_t e[2] = {i + halo->width[0], j + halo->width[1]};
+            FastPMFloat * row = from + e[0] * region->strides[0] + e[1] * region->strides[1];
+            FastPMFloat * out = to + i * pm->IRegion.strides[0] + j * pm->IRegion.strides[1];
+            ptrdiff_t size2 = region->size[2];
+            ptrdiff_t k;
+            int n;
+
+            if(dir < 0) {
+                memcpy(out, row, sizeof(out[0]) * size2);
+                continue;
+            }
+
+            if(dir == 2) {
+                /* the last axis is never decomposed */
+                for(k = 0; k < size2; k ++) {
+                    double g = 0;
+                    for(n = 1; n <= nc; n ++) {
+                        ptrdiff_t kp = k + n;
+                        ptrdiff_t km = k - n;
+                        if(kp >= size2) kp -= size2;
+                        if(km < 0) km += size2;
+                        g += coeff[n - 1] * (row[kp] - row[km]);
+                    }
+                    out[k] = g * InvCellSize;
+                }
+                continue;
+            }
+
+            /* the neighbouring rows are in the halo, or periodic if the axis is not decomposed */
+            FastPMFloat * plus[3];
+            FastPMFloat * minus[3];
+            for(n = 1; n <= nc; n ++) {
+                ptrdiff_t ep = e[dir] + n;
+                ptrdiff_t em = e[dir] - n;
+                if(halo->width[dir] == 0) {
+                    if(ep >= region->size[dir]) ep -= region->size[dir];
+                    if(em < 0) em += region->size[dir];
+                }
+                plus[n - 1] = row + (ep - e[dir]) * region->strides[dir];
+                minus[n - 1] = row + (em - e[dir]) * region->strides[dir];
+            }
+            for(k = 0; k < size2; k ++) {
+                double g = 0;
+                for(n = 0; n < nc; n ++) {
+                    g += coeff[n] * (plus[n][k] - minus[n][k]);
+                }
+                out[k] = g * InvCellSize;
+            }
+        }
+    }
+}
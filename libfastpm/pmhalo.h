@@ -0,0 +1,46 @@
+/* A mesh halo around the local region, as an alternative to particle ghosts.
+ *
+ * Painters bound to halo->pm paint the local particles into the local region
+ * extended by width cells on either side along the first two axes;
+ * pm_halo_reduce adds the halo cells onto the neighbours that own them.
+ * For the readout, pm_halo_fill copies the owned cells into the halo of the
+ * neighbours, such that the local particles are read out from the extended mesh.
+ *
+ * The particles shall be decomposed to pm; the traffic is a fixed
+ * surface of the local region, independent of the clustering.
+ *
+ * Meshes of halo->pm are allocated with pm_alloc(&halo->pm); halo->pm shall
+ * not be used for anything but painting and readout.
+ *
+ * A halo around a particle domain that is not the local region of pm is
+ * created by pm_domain_halo_init; see pmdomain.h.
+ * */
+typedef struct PMHalo {
+    PM * base;
+    PM pm;
+    ptrdiff_t width[2]; /* 0 along an axis that is not decomposed */
+    struct PMDomainRoute * route; /* NULL for the halo around the local region */
+} PMHalo;
+
+void
+pm_halo_init(PMHalo * halo, PM * pm, int width);
+
+void
+pm_halo_destroy(PMHalo * halo);
+
+void
+pm_halo_reduce(PMHalo * halo, FastPMFloat * from, FastPMFloat * to);
+
+void
+pm_halo_fill(PMHalo * halo, FastPMFloat * from, FastPMFloat * to);
+
+void
+pm_halo_paint(PMHalo * halo, FastPMPainter * painter, FastPMFloat * canvas,
+    FastPMStore * p, fastpm_posfunc get_position, enum FastPMPackFields attribute);
+
+void
+pm_halo_readout_multi(PMHalo * halo, FastPMPainter * painter, FastPMFloat ** canvas, int ncanvas,
+    FastPMStore * p, fastpm_posfunc get_position, enum FastPMPackFields * attributes);
+
+void
+pm_halo_gradient(PMHalo * halo, FastPMFloat * from, FastPMFloat * to, int dir, int npoints);
@@ -1,5 +1,8 @@
 #include <string.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <fftw3.h>
 #include <fftw3-mpi.h>
@@ -8,8 +11,12 @@
 #include <fastpm/libfastpm.h>
 #include <fastpm/logging.h>
 #include <fastpm/transfer.h>
+#include <fastpm/string.h>
 
 #include "pmpfft.h"
+#include "pmghosts.h"
+#include "pmhalo.h"
+#include "pmdomain.h"
 static MPI_Datatype MPI_PTRDIFF = (MPI_Datatype) 0;
 
 #if FASTPM_FFT_PRECISION == 64
@@ -25,6 +32,12 @@ static MPI_Datatype MPI_PTRDIFF = (MPI_Datatype) 0;
     #define _pfft_cleanup pfft_cleanup
     #define destroy_plan pfft_destroy_plan
     #define destroy_plan_fftw fftw_destroy_plan
+    #define import_wisdom_from_filename fftw_import_wisdom_from_filename
+    #define export_wisdom_to_filename fftw_export_wisdom_to_filename
+    #define mpi_broadcast_wisdom fftw_mpi_broadcast_wisdom
+    #define mpi_gather_wisdom fftw_mpi_gather_wisdom
+    #define _fftw_init_threads fftw_init_threads
+    #define _fftw_cleanup_threads fftw_cleanup_threads
 
 #elif FASTPM_FFT_PRECISION == 32
     #define plan_dft_r2c pfftf_plan_dft_r2c
@@ -39,14 +52,62 @@ static MPI_Datatype MPI_PTRDIFF = (MPI_Datatype) 0;
     #define _pfft_cleanup pfftf_cleanup
     #define destroy_plan pfftf_destroy_plan
     #define destroy_plan_fftw fftwf_destroy_plan
+    #define import_wisdom_from_filename fftwf_import_wisdom_from_filename
+    #define export_wisdom_to_filename fftwf_export_wisdom_to_filename
+    #define mpi_broadcast_wisdom fftwf_mpi_broadcast_wisdom
+    #define mpi_gather_wisdom fftwf_mpi_gather_wisdom
+    #define _fftw_init_threads fftwf_init_threads
+    #define _fftw_cleanup_threads fftwf_cleanup_threads
 #endif
 
+/* the suffix of the wisdom file of the single precision plans in a double precision build */
+#define REDUCED_WISDOM_SUFFIX ".f32"
+
+/* The FFT plans are shared by the PMs of the same mesh, process mesh and layout;
+ * e.g. the base PM and the VPM of pm_nc_factor 1. */
+struct PMPlan {
+    ptrdiff_t Nmesh;
+    int Nproc[2];
+    int transposed;
+    int use_fftw;
+    int precision;
+    int nthreads;
+    MPI_Comm comm;
+
+    void * r2c;
+    void * c2r;
+    /* the single precision mesh of the c2r of a reduced precision plan; NULL otherwise */
+    float * scratch;
+
+    int refcount;
+    struct PMPlan * next;
+};
+
+static struct PMPlan * PlanCache = NULL;
+
+/* measure the plans rather than estimate; worth it with wisdom that persists across runs. */
+static int PlanMeasure = 0;
+
+static void
+_pm_plan_destroy(struct PMPlan * plan);
+
 void
 pm_module_init() 
 {
     if(MPI_PTRDIFF) return;
         
+#ifdef _OPENMP
+    /* the threads are initialized before the MPI interfaces of FFTW */
+    _fftw_init_threads();
+#if FASTPM_FFT_PRECISION == 64
+    fftwf_init_threads();
+#endif
+#endif
     _pfft_init();
+#if FASTPM_FFT_PRECISION == 64
+    /* for the PMs with single precision transforms */
+    pfftf_init();
+#endif
 
     if(sizeof(ptrdiff_t) == 8) {
         MPI_PTRDIFF = MPI_LONG;
@@ -59,11 +120,91 @@ void
 pm_module_cleanup() 
 {
     if(!MPI_PTRDIFF) return;
+
+    while(PlanCache) {
+        struct PMPlan * plan = PlanCache;
+        PlanCache = plan->next;
+        _pm_plan_destroy(plan);
+    }
+
     _pfft_cleanup();
+#if FASTPM_FFT_PRECISION == 64
+    pfftf_cleanup();
+#endif
+#ifdef _OPENMP
+    _fftw_cleanup_threads();
+#if FASTPM_FFT_PRECISION == 64
+    fftwf_cleanup_threads();
+#endif
+#endif
 
     MPI_PTRDIFF = (MPI_Datatype) 0;
 }
 
+/* Read the FFTW wisdom of filename on the first rank and share it with the ranks of comm;
+ * the following plans are measured. A missing file is not an error. PFFT plans on top of
+ * FFTW, so the wisdom applies to both backends. */
+void
+pm_module_import_wisdom(const char * filename, MPI_Comm comm)
+{
+    int ThisTask;
+    MPI_Comm_rank(comm, &ThisTask);
+
+    int imported = 0;
+    if(ThisTask == 0) {
+        imported = import_wisdom_from_filename(filename);
+    }
+    MPI_Bcast(&imported, 1, MPI_INT, 0, comm);
+    if(imported) {
+        mpi_broadcast_wisdom(comm);
+    }
+#if FASTPM_FFT_PRECISION == 64
+    char * reduced = fastpm_strdup_printf("%s" REDUCED_WISDOM_SUFFIX, filename);
+    imported = 0;
+    if(ThisTask == 0) {
+        imported = fftwf_import_wisdom_from_filename(reduced);
+    }
+    MPI_Bcast(&imported, 1, MPI_INT, 0, comm);
+    if(imported) {
+        fftwf_mpi_broadcast_wisdom(comm);
+    }
+    free(reduced);
+#endif
+    PlanMeasure = 1;
+}
+
+/* Write the FFTW wisdom gathered from the ranks of comm to filename on the first rank. In a
+ * double precision build the wisdom of the single precision plans goes to filename.f32. */
+void
+pm_module_export_wisdom(const char * filename, MPI_Comm comm)
+{
+    int ThisTask;
+    MPI_Comm_rank(comm, &ThisTask);
+
+    mpi_gather_wisdom(comm);
+
+    int exported = 1;
+    if(ThisTask == 0) {
+        exported = export_wisdom_to_filename(filename);
+    }
+    MPI_Bcast(&exported, 1, MPI_INT, 0, comm);
+    if(!exported) {
+        fastpm_raise(-1, "Failed to write the FFT wisdom to %s.\n", filename);
+    }
+#if FASTPM_FFT_PRECISION == 64
+    char * reduced = fastpm_strdup_printf("%s" REDUCED_WISDOM_SUFFIX, filename);
+    fftwf_mpi_gather_wisdom(comm);
+    if(ThisTask == 0) {
+        exported = fftwf_export_wisdom_to_filename(reduced);
+    }
+    MPI_Bcast(&exported, 1, MPI_INT, 0, comm);
+    if(!exported) {
+        fastpm_raise(-1, "Failed to write the FFT wisdom to %s.\n", reduced);
+    }
+    free(reduced);
+#endif
+}
+
 static size_t fftw_local_size_dft_r2c(int nrnk, ptrdiff_t * n, MPI_Comm comm,
                         int flags, 
                         ptrdiff_t * isize, ptrdiff_t * istart,
@@ -105,10 +246,247 @@ static size_t fftw_local_size_dft_r2c(int nrnk, ptrdiff_t * n, MPI_Comm comm,
     return allocsize;
 }
 
+#if FASTPM_FFT_PRECISION == 64
+/* The PMs of fft_precision 32 in a double precision build keep the meshes in double
+ * precision, but transform in single precision: the meshes are narrowed to float before
+ * and widened after the transforms, which halves the FFT bandwidth and the volume of the
+ * transposes. The r2c narrows into its output mesh; the c2r into the scratch of the plan,
+ * which is allocated once with the plan. */
+static void
+_pm_plan_reduced(PM * pm, struct PMPlan * plan, float * canvas, float * workspace)
+{
+    plan->scratch = malloc(sizeof(float) * pm->allocsize);
+
+    if(pm->init.use_fftw) {
+        plan->r2c = fftwf_mpi_plan_dft_r2c(
+                3, pm->Nmesh, workspace, (void*) canvas,
+                pm->Comm2D,
+                (pm->init.transposed?FFTW_MPI_TRANSPOSED_OUT:0)
+                | (PlanMeasure?FFTW_MEASURE:FFTW_ESTIMATE)
+                | FFTW_DESTROY_INPUT
+                );
+        plan->c2r = fftwf_mpi_plan_dft_c2r(
+                3, pm->Nmesh, (void*) plan->scratch, plan->scratch,
+                pm->Comm2D,
+                (pm->init.transposed?FFTW_MPI_TRANSPOSED_IN:0)
+                | (PlanMeasure?FFTW_MEASURE:FFTW_ESTIMATE)
+                | FFTW_DESTROY_INPUT
+                );
+    } else {
+        plan->r2c = pfftf_plan_dft_r2c(
+                3, pm->Nmesh, workspace, (void*) canvas,
+                pm->Comm2D,
+                PFFT_FORWARD,
+                (pm->init.transposed?PFFT_TRANSPOSED_OUT:0)
+                | PFFT_PADDED_R2C
+                | (PlanMeasure?PFFT_MEASURE:PFFT_ESTIMATE)
+                | PFFT_TUNE
+                | PFFT_DESTROY_INPUT
+                );
+        plan->c2r = pfftf_plan_dft_c2r(
+                3, pm->Nmesh, (void*) plan->scratch, plan->scratch,
+                pm->Comm2D,
+                PFFT_BACKWARD,
+                (pm->init.transposed?PFFT_TRANSPOSED_IN:0)
+                | PFFT_PADDED_C2R
+                | (PlanMeasure?PFFT_MEASURE:PFFT_ESTIMATE)
+                | PFFT_TUNE
+                | PFFT_DESTROY_INPUT
+                );
+    }
+}
+
+/* from is destroyed, as with the double precision plans. */
+static void
+_pm_r2c_reduced(PM * pm, FastPMFloat * from, FastPMFloat * to)
+{
+    float * ffrom = (float*) to;
+    float * fto = (float*) from;
+    ptrdiff_t i;
+#pragma omp parallel for
+    for(i = 0; i < pm->allocsize; i ++) {
+        ffrom[i] = from[i];
+    }
+    if(pm->init.use_fftw) {
+        fftwf_mpi_execute_dft_r2c(pm->r2c, ffrom, (void*) fto);
+    } else {
+        pfftf_execute_dft_r2c(pm->r2c, ffrom, (void*) fto);
+    }
+#pragma omp parallel for
+    for(i = 0; i < pm->allocsize; i ++) {
+        to[i] = fto[i];
+    }
+}
+
+static void
+_pm_c2r_reduced(PM * pm, FastPMFloat * inplace)
+{
+    float * finplace = pm->Plan->scratch;
+    ptrdiff_t i;
+#pragma omp parallel for
+    for(i = 0; i < pm->allocsize; i ++) {
+        finplace[i] = inplace[i];
+    }
+    if(pm->init.use_fftw) {
+        fftwf_mpi_execute_dft_c2r(pm->c2r, (void*) finplace, finplace);
+    } else {
+        pfftf_execute_dft_c2r(pm->c2r, (void*) finplace, finplace);
+    }
+#pragma omp parallel for
+    for(i = 0; i < pm->allocsize; i ++) {
+        inplace[i] = finplace[i];
+    }
+}
+#endif
+
+/* the shared plans for pm, planned on first use */
+static struct PMPlan *
+_pm_plan_get(PM * pm, MPI_Comm comm)
+{
+    struct PMPlan * plan;
+    for(plan = PlanCache; plan; plan = plan->next) {
+        int result;
+        MPI_Comm_compare(plan->comm, comm, &result);
+        if(result != MPI_IDENT && result != MPI_CONGRUENT) continue;
+        if(plan->Nmesh != pm->init.Nmesh) continue;
+        if(plan->Nproc[0] != pm->Nproc[0] || plan->Nproc[1] != pm->Nproc[1]) continue;
+        if(plan->transposed != pm->init.transposed) continue;
+        if(plan->use_fftw != pm->init.use_fftw) continue;
+        if(plan->precision != pm->init.fft_precision) continue;
+        if(plan->nthreads != pm->init.fft_threads) continue;
+        plan->refcount ++;
+        return plan;
+    }
+
+    plan = malloc(sizeof(plan[0]));
+    plan->Nmesh = pm->init.Nmesh;
+    plan->Nproc[0] = pm->Nproc[0];
+    plan->Nproc[1] = pm->Nproc[1];
+    plan->transposed = pm->init.transposed;
+    plan->use_fftw = pm->init.use_fftw;
+    plan->precision = pm->init.fft_precision;
+    plan->nthreads = pm->init.fft_threads;
+    plan->scratch = NULL;
+    MPI_Comm_dup(comm, &plan->comm);
+
+#ifdef _OPENMP
+    /* the plans execute with the threads they are planned with */
+    if(plan->precision == 32) {
+        pfftf_plan_with_nthreads(plan->nthreads);
+        fftwf_plan_with_nthreads(plan->nthreads);
+    } else {
+        pfft_plan_with_nthreads(plan->nthreads);
+        fftw_plan_with_nthreads(plan->nthreads);
+    }
+#endif
+
+    FastPMFloat * canvas = pm_alloc(pm);
+    FastPMFloat * workspace = pm_alloc(pm);
+
+    if(plan->precision != FASTPM_FFT_PRECISION) {
+#if FASTPM_FFT_PRECISION == 64
+        _pm_plan_reduced(pm, plan, (float*) canvas, (float*) workspace);
+#endif
+    } else
+    if(pm->init.use_fftw) {
+        plan->r2c = plan_dft_r2c_fftw(
+                3, pm->Nmesh, (void*) workspace, (void*) canvas, 
+                pm->Comm2D, 
+                (pm->init.transposed?FFTW_MPI_TRANSPOSED_OUT:0)
+                | (PlanMeasure?FFTW_MEASURE:FFTW_ESTIMATE)
+                | FFTW_DESTROY_INPUT
+                );
+        plan->c2r = plan_dft_c2r_fftw(
+                3, pm->Nmesh, (void*) canvas, (void*) canvas, 
+                pm->Comm2D, 
+                (pm->init.transposed?FFTW_MPI_TRANSPOSED_IN:0)
+                | (PlanMeasure?FFTW_MEASURE:FFTW_ESTIMATE)
+                | FFTW_DESTROY_INPUT
+                );
+    } else {
+        plan->r2c = plan_dft_r2c(
+                3, pm->Nmesh, (void*) workspace, (void*) canvas, 
+                pm->Comm2D,
+                PFFT_FORWARD, 
+                (pm->init.transposed?PFFT_TRANSPOSED_OUT:0)
+                | PFFT_PADDED_R2C 
+                | (PlanMeasure?PFFT_MEASURE:PFFT_ESTIMATE)
+                | PFFT_TUNE
+                | PFFT_DESTROY_INPUT
+                );
+        plan->c2r = plan_dft_c2r(
+                3, pm->Nmesh, (void*) workspace, (void*) workspace, 
+                pm->Comm2D,
+                PFFT_BACKWARD, 
+                (pm->init.transposed?PFFT_TRANSPOSED_IN:0)
+                | PFFT_PADDED_C2R 
+                | (PlanMeasure?PFFT_MEASURE:PFFT_ESTIMATE)
+                | PFFT_TUNE
+                | PFFT_DESTROY_INPUT
+                );
+    }
+
+    pm_free(pm, workspace);
+    pm_free(pm, canvas);
+
+    plan->refcount = 1;
+    plan->next = PlanCache;
+    PlanCache = plan;
+    return plan;
+}
+
+static void
+_pm_plan_destroy(struct PMPlan * plan)
+{
+    if(plan->precision != FASTPM_FFT_PRECISION) {
+#if FASTPM_FFT_PRECISION == 64
+        if(plan->use_fftw) {
+            fftwf_destroy_plan(plan->r2c);
+            fftwf_destroy_plan(plan->c2r);
+        } else {
+            pfftf_destroy_plan(plan->r2c);
+            pfftf_destroy_plan(plan->c2r);
+        }
+#endif
+    } else
+    if(plan->use_fftw) {
+        destroy_plan_fftw(plan->r2c);
+        destroy_plan_fftw(plan->c2r);
+    } else {
+        destroy_plan(plan->r2c);
+        destroy_plan(plan->c2r);
+    }
+    free(plan->scratch);
+    MPI_Comm_free(&plan->comm);
+    free(plan);
+}
+
+static void
+_pm_plan_release(struct PMPlan * plan)
+{
+    plan->refcount --;
+    if(plan->refcount > 0) return;
+
+    struct PMPlan ** p;
+    for(p = &PlanCache; *p != plan; p = &(*p)->next) continue;
+    *p = plan->next;
+    _pm_plan_destroy(plan);
+}
+
 void pm_init(PM * pm, PMInit * init, MPI_Comm comm) {
 
+    if(init->autotune) {
+        PMInit tuned = *init;
+        tuned.autotune = 0;
+        pm_autotune(&tuned, comm);
+        pm_init(pm, &tuned, comm);
+        return;
+    }
+
     pm->init = *init;
     pm->mem = _libfastpm_get_gmem();
+    pm->GhostPlan = NULL;
+    pm->Domain = NULL;
 
     /* initialize the domain */
     MPI_Comm_rank(comm, &pm->ThisTask);
@@ -140,6 +518,23 @@ void pm_init(PM * pm, PMInit * init, MPI_Comm comm) {
         }
     }
     int d;
+    if(pm->init.fft_threads <= 0) {
+#ifdef _OPENMP
+        pm->init.fft_threads = omp_get_max_threads();
+#else
+        pm->init.fft_threads = 1;
+#endif
+    }
+    if(pm->init.fft_precision == 0) {
+        pm->init.fft_precision = FASTPM_FFT_PRECISION;
+    }
+    if(pm->init.fft_precision != 32 && pm->init.fft_precision != 64) {
+        fastpm_raise(-1, "FFT precision must be 32 or 64, but is %d.\n", pm->init.fft_precision);
+    }
+    if(pm->init.fft_precision > FASTPM_FFT_PRECISION) {
+        fastpm_raise(-1, "FFT precision %d is higher than the mesh precision %d of this build.\n",
+            pm->init.fft_precision, FASTPM_FFT_PRECISION);
+    }
     if(init->Nmesh % 2 != 0) {
         fastpm_raise(-1, "Nmesh must be even, but %d is odd.\n", init->Nmesh);
     }
@@ -151,6 +546,7 @@ void pm_init(PM * pm, PMInit * init, MPI_Comm comm) {
 
         pm->Below[d] = 0;
         pm->Above[d] = 1;
+        pm->HalfCellPhase[d] = NULL;
 
         pm->CellSize[d] = pm->BoxSize[d] / pm->Nmesh[d];
         pm->InvCellSize[d] = 1.0 / pm->CellSize[d]; 
@@ -246,51 +642,9 @@ void pm_init(PM * pm, PMInit * init, MPI_Comm comm) {
         }
     }
 
-    FastPMFloat * canvas = pm_alloc(pm);
-    FastPMFloat * workspace = pm_alloc(pm);
-
-    if(pm->init.use_fftw) {
-        pm->r2c = plan_dft_r2c_fftw(
-                3, pm->Nmesh, (void*) workspace, (void*) canvas, 
-                pm->Comm2D, 
-                (pm->init.transposed?FFTW_MPI_TRANSPOSED_OUT:0)
-                | FFTW_ESTIMATE 
-                | FFTW_DESTROY_INPUT
-                );
-        pm->c2r = plan_dft_c2r_fftw(
-                3, pm->Nmesh, (void*) canvas, (void*) canvas, 
-                pm->Comm2D, 
-                (pm->init.transposed?FFTW_MPI_TRANSPOSED_IN:0)
-                | FFTW_ESTIMATE 
-                | FFTW_DESTROY_INPUT
-                );
-    } else {
-        pm->r2c = plan_dft_r2c(
-                3, pm->Nmesh, (void*) workspace, (void*) canvas, 
-                pm->Comm2D,
-                PFFT_FORWARD, 
-                (pm->init.transposed?PFFT_TRANSPOSED_OUT:0)
-                | PFFT_PADDED_R2C 
-                | PFFT_ESTIMATE 
-                | PFFT_TUNE
-                //| PFFT_MEASURE
-                | PFFT_DESTROY_INPUT
-                );
-        pm->c2r = plan_dft_c2r(
-                3, pm->Nmesh, (void*) workspace, (void*) workspace, 
-                pm->Comm2D,
-                PFFT_BACKWARD, 
-                (pm->init.transposed?PFFT_TRANSPOSED_IN:0)
-                | PFFT_PADDED_C2R 
-                | PFFT_ESTIMATE 
-                //| PFFT_MEASURE
-                | PFFT_TUNE
-                | PFFT_DESTROY_INPUT
-                );
-    }
-
-    pm_free(pm, workspace);
-    pm_free(pm, canvas);
+    pm->Plan = _pm_plan_get(pm, comm);
+    pm->r2c = pm->Plan->r2c;
+    pm->c2r = pm->Plan->c2r;
 
     for(d = 0; d < 3; d++) {
         pm->MeshtoK[d] = malloc(pm->Nmesh[d] * sizeof(double));
@@ -305,6 +659,106 @@ void pm_init(PM * pm, PMInit * init, MPI_Comm comm) {
     }
 }
 
+/* the wall time of a pair of transforms of pm, the slowest of the ranks */
+static double
+_pm_time_transforms(PM * pm, int ntrials)
+{
+    FastPMFloat * from = pm_alloc(pm);
+    FastPMFloat * to = pm_alloc(pm);
+    double best = 0;
+    int t;
+    /* the first round warms up the caches and the pages of the buffers */
+    for(t = 0; t <= ntrials; t ++) {
+        ptrdiff_t i;
+#pragma omp parallel for
+        for(i = 0; i < pm->allocsize; i ++) {
+            from[i] = (i % 7) * 0.1;
+        }
+        MPI_Barrier(pm->Comm2D);
+        double t0 = MPI_Wtime();
+        pm_r2c_unnormalized(pm, from, to);
+        pm_c2r(pm, to);
+        double t1 = MPI_Wtime() - t0;
+        MPI_Allreduce(MPI_IN_PLACE, &t1, 1, MPI_DOUBLE, MPI_MAX, pm->Comm2D);
+        if(t == 1 || (t > 1 && t1 < best)) best = t1;
+    }
+    pm_free(pm, to);
+    pm_free(pm, from);
+    return best;
+}
+
+/* Choose NprocY (unless given) and fft_threads of init by timing the transforms of a few
+ * candidates: the process meshes of NprocY dividing the number of ranks with NprocY^2 <= NTask
+ * (1 for FFTW), and the full, half and quarter of the OpenMP threads. */
+void
+pm_autotune(PMInit * init, MPI_Comm comm)
+{
+    int NTask;
+    MPI_Comm_size(comm, &NTask);
+
+#ifdef _OPENMP
+    int maxthreads = omp_get_max_threads();
+#else
+    int maxthreads = 1;
+#endif
+
+    int Ny[32];
+    int nNy = 0;
+    if(init->NprocY > 0) {
+        Ny[nNy++] = init->NprocY;
+    } else if(init->use_fftw) {
+        Ny[nNy++] = 1;
+    } else {
+        int y;
+        for(y = 1; y * y <= NTask && nNy < 32; y ++) {
+            if(NTask % y != 0) continue;
+            /* PFFT needs a cell per rank along each axis */
+            if(NTask / y > init->Nmesh) continue;
+            Ny[nNy++] = y;
+        }
+        if(nNy == 0) Ny[nNy++] = 1;
+    }
+
+    int nthreads[3];
+    nthreads[0] = maxthreads;
+    int nnthreads = 1;
+    int n;
+    for(n = maxthreads / 2; n >= 1 && nnthreads < 3; n /= 2) {
+        nthreads[nnthreads++] = n;
+    }
+
+    double best = -1;
+    int bestNy = Ny[0];
+    int bestthreads = nthreads[0];
+    int i, j;
+    for(i = 0; i < nNy; i ++) {
+        for(j = 0; j < nnthreads; j ++) {
+            PMInit trial = *init;
+            trial.NprocY = Ny[i];
+            trial.fft_threads = nthreads[j];
+            trial.autotune = 0;
+
+            PM pm[1];
+            pm_init(pm, &trial, comm);
+            double t = _pm_time_transforms(pm, 2);
+            pm_destroy(pm);
+
+            fastpm_info("FFT of Nmesh %td on %d x %d ranks with %d threads: %g s\n",
+                init->Nmesh, NTask / Ny[i], Ny[i], nthreads[j], t);
+            if(best < 0 || t < best) {
+                best = t;
+                bestNy = Ny[i];
+                bestthreads = nthreads[j];
+            }
+        }
+    }
+    fastpm_info("FFT of Nmesh %td: chose %d x %d ranks with %d threads.\n",
+        init->Nmesh, NTask / bestNy, bestNy, bestthreads);
+
+    init->NprocY = bestNy;
+    init->fft_threads = bestthreads;
+}
+
 void 
 pm_init_simple(PM * pm, int Ngrid, double BoxSize, MPI_Comm comm)
 {
@@ -324,15 +778,19 @@ void
 pm_destroy(PM * pm) 
 {
     int d;
-    if(pm->init.use_fftw) {
-        destroy_plan_fftw(pm->r2c);
-        destroy_plan_fftw(pm->c2r);
-    } else {
-        destroy_plan(pm->r2c);
-        destroy_plan(pm->c2r);
-    }
+    _pm_plan_release(pm->Plan);
+    pm->Plan = NULL;
     for(d = 0; d < 3; d++) {
         free(pm->MeshtoK[d]);
+        free(pm->HalfCellPhase[d]);
+    }
+    if(pm->GhostPlan) {
+        pm_ghosts_plan_free(pm->GhostPlan);
+        pm->GhostPlan = NULL;
+    }
+    if(pm->Domain) {
+        pm_domain_free(pm->Domain);
+        pm->Domain = NULL;
     }
 }   
 
@@ -362,11 +820,8 @@ void pm_r2c(PM * pm, FastPMFloat * from, FastPMFloat * to) {
     /* A gaussian of variance 1 becomes a complex gausian of variance 1/2 * (1 / Norm) in real and imag */
 
     /* workspace to canvas*/
-    if(pm->init.use_fftw) {
-        execute_dft_r2c_fftw(pm->r2c, from, (void*)to);
-    } else {
-        execute_dft_r2c(pm->r2c, from, (void*)to);
-    }
+    pm_r2c_unnormalized(pm, from, to);
+
     ptrdiff_t i;
 #pragma omp parallel for
     for(i = 0; i < pm->allocsize; i ++) {
@@ -374,8 +829,28 @@ void pm_r2c(PM * pm, FastPMFloat * from, FastPMFloat * to) {
     }
 }
 
+void pm_r2c_unnormalized(PM * pm, FastPMFloat * from, FastPMFloat * to) {
+#if FASTPM_FFT_PRECISION == 64
+    if(pm->init.fft_precision != FASTPM_FFT_PRECISION) {
+        _pm_r2c_reduced(pm, from, to);
+        return;
+    }
+#endif
+    if(pm->init.use_fftw) {
+        execute_dft_r2c_fftw(pm->r2c, from, (void*)to);
+    } else {
+        execute_dft_r2c(pm->r2c, from, (void*)to);
+    }
+}
+
 void pm_c2r(PM * pm, FastPMFloat * inplace) {
     /* r2c and c2r round trip is unitary */
+#if FASTPM_FFT_PRECISION == 64
+    if(pm->init.fft_precision != FASTPM_FFT_PRECISION) {
+        _pm_c2r_reduced(pm, inplace);
+        return;
+    }
+#endif
     if(pm->init.use_fftw) {
         execute_dft_c2r_fftw(pm->c2r, (void*) inplace, inplace);
     } else {
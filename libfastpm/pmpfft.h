@@ -18,12 +18,26 @@
 #define UNLIKELY(x) __builtin_expect(!!(x), 0)
 #endif
 
+/* compile a hot loop for several instruction sets; the best is picked at load time.
+ * no-trapping-math allows floor() to be vectorized. */
+#ifndef FASTPM_TARGET_CLONES
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__) && defined(__linux__)
+#define FASTPM_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default"), optimize("no-trapping-math")))
+#else
+#define FASTPM_TARGET_CLONES
+#endif
+#endif
+
 typedef struct {
     ptrdiff_t Nmesh;
     double BoxSize;
     int NprocY;
     int transposed;
     int use_fftw;
+    int mesh_halo; /* paint and read out through a mesh halo instead of particle ghosts; see pmhalo.h */
+    int fft_precision; /* 32 or 64 for the transforms; 0 for FASTPM_FFT_PRECISION. at most FASTPM_FFT_PRECISION. */
+    int fft_threads; /* OpenMP threads of the transforms; 0 for all */
+    int autotune; /* choose NprocY (if 0) and fft_threads by timing the transforms; see pm_autotune */
 } PMInit;
 
 typedef struct {
@@ -40,6 +54,7 @@ struct PM {
 
     void * r2c;   /* Forward r2c plan */
     void * c2r;   /* Bacward c2r plan */
+    struct PMPlan * Plan; /* the owner of the plans, shared with the PMs of the same layout; see pmpfft.c */
 
     int Nproc[2];
     MPI_Comm Comm2D;
@@ -56,11 +71,20 @@ struct PM {
 
     PMGrid Grid;
     double * MeshtoK[3];
+    /* cos and sin of the phase of a half cell shift per mesh index, interleaved;
+     * built on first use by the interlacing, see gravity.c */
+    double * HalfCellPhase[3];
     double Norm;
     double Volume;
     double CellSize[3];
     double InvCellSize[3];
 
+    /* neighbour pattern of the ghost exchange, built on first use; see pmghosts.c */
+    struct PMGhostPlan * GhostPlan;
+
+    /* balanced particle domains, if the particles are not decomposed to the pencils; see pmdomain.c */
+    struct PMDomain * Domain;
+
     FastPMMemory * mem;
 };
 
@@ -70,6 +94,12 @@ pm_module_init();
 void
 pm_module_cleanup();
 
+void
+pm_module_import_wisdom(const char * filename, MPI_Comm comm);
+
+void
+pm_module_export_wisdom(const char * filename, MPI_Comm comm);
+
 /* Initializing a PM object. */
 void 
 pm_init(PM * pm, PMInit * init, MPI_Comm comm);
@@ -77,6 +107,9 @@ pm_init(PM * pm, PMInit * init, MPI_Comm comm);
 void 
 pm_init_simple(PM * pm, int Ngrid, double BoxSize, MPI_Comm comm);
 
+void
+pm_autotune(PMInit * init, MPI_Comm comm);
+
 void pm_destroy(PM * pm);
 
 int pm_pos_to_rank(PM * pm, double pos[3]);
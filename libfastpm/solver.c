@@ -13,6 +13,8 @@
 #include "pmpfft.h"
 #include "pm2lpt.h"
 #include "pmghosts.h"
+#include "pmhalo.h"
+#include "pmdomain.h"
 #include "vpm.h"
 
 static void
@@ -31,6 +33,8 @@ void fastpm_solver_init(FastPMSolver * fastpm,
     fastpm->gravity[0] = (FastPMGravity) {
         .PainterType = config->PAINTER_TYPE,
         .PainterSupport = config->painter_support,
+        .Interlacing = config->painter_interlacing,
+        .ReadoutCanvases = config->readout_canvases,
         .KernelType = config->KERNEL_TYPE,
         .DealiasingType = config->DEALIASING_TYPE,
     };
@@ -41,6 +45,9 @@ void fastpm_solver_init(FastPMSolver * fastpm,
     };
 
     fastpm->event_handlers = NULL;
+    fastpm->nunsorted = 0;
+    fastpm->info.imbalance.peak = 0;
+    fastpm->info.imbalance.np_peak = 0;
 
     PMInit baseinit = {
             .Nmesh = config->nc,
@@ -48,6 +55,8 @@ void fastpm_solver_init(FastPMSolver * fastpm,
             .NprocY = config->NprocY, /* 0 for auto, 1 for slabs */
             .transposed = 1,
             .use_fftw = config->UseFFTW,
+            .mesh_halo = config->mesh_halo,
+            .autotune = config->TuneFFT,
         };
 
     fastpm->comm = comm;
@@ -58,22 +67,40 @@ void fastpm_solver_init(FastPMSolver * fastpm,
     fastpm->p = malloc(sizeof(FastPMStore));
 
     fastpm_store_init_evenly(fastpm->p, pow(1.0 * config->nc, 3),
-          PACK_POS | PACK_VEL | PACK_ID
+          (config->fixed_point_positions?PACK_POS_FIXED:PACK_POS)
+        | PACK_VEL | PACK_ID
         | PACK_DX1 | PACK_DX2 | PACK_ACC
         | (config->SAVE_Q?PACK_Q:0)
         | (config->COMPUTE_POTENTIAL?PACK_POTENTIAL:0),
         config->alloc_factor, comm);
 
+    int d;
+    for(d = 0; d < 3; d ++) {
+        fastpm->p->BoxSize[d] = config->boxsize;
+    }
+
     fastpm->vpm_list = vpm_create(config->vpminit,
                            &baseinit, comm);
 
+    /* basepm shares the process mesh of the VPMs, such that the particles
+     * decomposed on a VPM are also decomposed on basepm; the FFT threads are
+     * shared with a VPM of the same Nmesh, or tuned if there is none. */
     PMInit basepminit = {
             .Nmesh = config->nc,
             .BoxSize = config->boxsize,
-            .NprocY = 0, /* 0 for auto, 1 for slabs */
+            .NprocY = fastpm->vpm_list[0].pm.Nproc[1],
             .transposed = 1,
             .use_fftw = 0,
+            .autotune = config->TuneFFT,
         };
+    VPM * vpm;
+    for(vpm = fastpm->vpm_list; !vpm->end; vpm ++) {
+        if(vpm->pm.init.Nmesh == basepminit.Nmesh) {
+            basepminit.fft_threads = vpm->pm.init.fft_threads;
+            basepminit.autotune = 0;
+            break;
+        }
+    }
 
     fastpm->basepm = malloc(sizeof(PM));
     pm_init(fastpm->basepm, &basepminit, fastpm->comm);
@@ -218,6 +245,17 @@ fastpm_do_warmup(FastPMSolver * fastpm, double a0)
 
     pm_2lpt_evolve(a0, fastpm->p, fastpm->cosmology, config->USE_DX1_ONLY);
 
+    FastPMStore * p = fastpm->p;
+    if(config->FORCE_TYPE == FASTPM_FORCE_FASTPM
+    || config->FORCE_TYPE == FASTPM_FORCE_PM) {
+        /* FASTPM and PM only use the displacements of LPT for the initial condition */
+        fastpm_memory_free(p->mem, p->dx2);
+        fastpm_memory_free(p->mem, p->dx1);
+        p->dx1 = NULL;
+        p->dx2 = NULL;
+        p->attributes &= ~(PACK_DX1 | PACK_DX2);
+    }
+
     LEAVE(warmup);
 }
 
@@ -364,7 +402,31 @@ fastpm_decompose(FastPMSolver * fastpm) {
 
     /* apply periodic boundary and move particles to the correct rank */
     fastpm_store_wrap(fastpm->p, pm->BoxSize);
-    fastpm_store_decompose(fastpm->p, (fastpm_store_target_func) FastPMTargetPM, pm, fastpm->comm);
+    if(fastpm->config->balance_domains) {
+        /* the patches around the domains are as wide as the support of the painter */
+        FastPMPainter painter[1];
+        fastpm_painter_init(painter, pm, fastpm->gravity->PainterType, fastpm->gravity->PainterSupport);
+        pm_domain_balance(pm, p, painter->support);
+        fastpm_store_decompose(fastpm->p, (fastpm_store_target_func) FastPMTargetDomain, pm->Domain, fastpm->comm);
+    } else {
+        fastpm_store_decompose_pm(fastpm->p, pm, fastpm->comm);
+    }
+
+    /* the order of the particles becomes random with respect to the cells as they
+     * move and migrate; restore the locality of painting and reading out. */
+    FastPMConfig * config = fastpm->config;
+    int sort = 0;
+    fastpm->nunsorted ++;
+    if(config->sort_interval > 0 && fastpm->nunsorted >= config->sort_interval) {
+        sort = 1;
+    }
+    if(config->sort_locality > 0 && fastpm_store_cell_locality(p, pm) < config->sort_locality) {
+        sort = 1;
+    }
+    if(sort) {
+        fastpm_store_sort_by_cell(p, pm);
+        fastpm->nunsorted = 0;
+    }
     size_t np_max;
     size_t np_min;
 
@@ -376,6 +438,12 @@ fastpm_decompose(FastPMSolver * fastpm) {
 
     fastpm->info.imbalance.min = np_min / np_mean;
     fastpm->info.imbalance.max = np_max / np_mean;
+    if(fastpm->info.imbalance.max > fastpm->info.imbalance.peak) {
+        fastpm->info.imbalance.peak = fastpm->info.imbalance.max;
+    }
+    if(np_max > fastpm->info.imbalance.np_peak) {
+        fastpm->info.imbalance.np_peak = np_max;
+    }
 }
 
 /* Interpolate position and velocity for snapshot at a=aout */
@@ -442,6 +510,6 @@ fastpm_set_snapshot(FastPMSolver * fastpm,
     po->a_x = po->a_v = aout;
 
     fastpm_store_wrap(po, pm->BoxSize);
-    fastpm_store_decompose(po, (fastpm_store_target_func) FastPMTargetPM, pm, fastpm->comm);
+    fastpm_store_decompose_pm(po, pm, fastpm->comm);
 }
 
@@ -1,12 +1,17 @@
 #include <string.h>
+#include <math.h>
 
 #include <mpi.h>
 #include <pfft.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <fastpm/libfastpm.h>
 #include <fastpm/logging.h>
 
 #include "pmpfft.h"
+#include "permute.h"
 
 #define HAS(a, b) ((a & b) != 0)
 
@@ -17,11 +22,51 @@ void fastpm_store_get_position(FastPMStore * p, ptrdiff_t index, double pos[3])
     pos[2] = p->x[index][2];
 }
 
+void fastpm_store_get_position_fixed(FastPMStore * p, ptrdiff_t index, double pos[3])
+{
+    int d;
+    for(d = 0; d < 3; d ++) {
+        pos[d] = p->xfixed[index][d] * (p->BoxSize[d] / 4294967296.0);
+    }
+}
+
+/* Store the position of particle index; the fixed point positions are wrapped into the box. */
+void fastpm_store_set_position(FastPMStore * p, ptrdiff_t index, double pos[3])
+{
+    int d;
+    if(p->x) {
+        for(d = 0; d < 3; d ++) {
+            p->x[index][d] = pos[d];
+        }
+        return;
+    }
+    for(d = 0; d < 3; d ++) {
+        double f = pos[d] / p->BoxSize[d];
+        f -= floor(f);
+        /* rounding up to 2**32 wraps to 0 */
+        p->xfixed[index][d] = (uint32_t) (uint64_t) llrint(f * 4294967296.0);
+    }
+}
+
 void fastpm_store_get_lagrangian_position(FastPMStore * p, ptrdiff_t index, double pos[3])
 {
-    pos[0] = p->q[index][0];
-    pos[1] = p->q[index][1];
-    pos[2] = p->q[index][2];
+    if(p->q) {
+        pos[0] = p->q[index][0];
+        pos[1] = p->q[index][1];
+        pos[2] = p->q[index][2];
+        return;
+    }
+    if(p->id == NULL || p->lagrangian.Nc[0] == 0) {
+        fastpm_raise(-1, "The Lagrangian position is neither stored nor derivable from the id.\n");
+    }
+    /* id = ii * Nc[1] * Nc[2] + jj * Nc[2] + kk */
+    uint64_t id = p->id[index];
+    int d;
+    for(d = 2; d >= 0; d --) {
+        ptrdiff_t pabs = id % p->lagrangian.Nc[d];
+        id /= p->lagrangian.Nc[d];
+        pos[d] = pabs * p->lagrangian.CellSize[d] + p->lagrangian.shift[d];
+    }
 }
 
 static size_t pack(FastPMStore * p, ptrdiff_t index, void * buf, enum FastPMPackFields flags) {
@@ -45,6 +90,7 @@ static size_t pack(FastPMStore * p, ptrdiff_t index, void * buf, enum FastPMPack
     size_t s = 0;
     char * ptr = (char*) buf;
     DISPATCH(PACK_POS, x)
+    DISPATCH(PACK_POS_FIXED, xfixed)
     DISPATCH(PACK_VEL, v)
     DISPATCH(PACK_ID, id)
     DISPATCH(PACK_DENSITY, rho)
@@ -52,6 +98,17 @@ static size_t pack(FastPMStore * p, ptrdiff_t index, void * buf, enum FastPMPack
     DISPATCH(PACK_DX1, dx1)
     DISPATCH(PACK_DX2, dx2)
     DISPATCH(PACK_Q, q)
+    if(HAS(flags, PACK_Q) && p->id) {
+        /* derived from the id */
+        if(ptr) {
+            double q[3];
+            fastpm_store_get_lagrangian_position(p, index, q);
+            float qf[3] = {q[0], q[1], q[2]};
+            memcpy(&ptr[s], qf, sizeof(qf));
+        }
+        s += sizeof(float) * 3;
+        flags &= ~PACK_Q;
+    }
     DISPATCH(PACK_AEMIT, aemit)
     DISPATCH(PACK_ACC, acc)
     DISPATCH(PACK_TIDAL, tidal)
@@ -104,6 +161,7 @@ static void unpack(FastPMStore * p, ptrdiff_t index, void * buf, enum FastPMPack
         } \
     }
     DISPATCH(PACK_POS, x)
+    DISPATCH(PACK_POS_FIXED, xfixed)
     DISPATCH(PACK_VEL, v)
     DISPATCH(PACK_ID, id)
     DISPATCH(PACK_DENSITY, rho)
@@ -304,6 +362,14 @@ fastpm_store_init(FastPMStore * p, size_t np_upper, enum FastPMPackFields attrib
     else
         p->x = NULL;
 
+    if(attributes & PACK_POS_FIXED)
+        p->xfixed = fastpm_memory_alloc(p->mem, sizeof(p->xfixed[0]) * np_upper, loc);
+    else
+        p->xfixed = NULL;
+
+    if(p->xfixed && !p->x)
+        p->get_position = fastpm_store_get_position_fixed;
+
 
     if(attributes & PACK_VEL)
         p->v = fastpm_memory_alloc(p->mem, sizeof(p->v[0]) * np_upper, loc);
@@ -361,6 +427,37 @@ fastpm_store_init_evenly(FastPMStore * p, size_t np_total, enum FastPMPackFields
     return 0;
 }
 
+void
+fastpm_store_reserve(FastPMStore * p, size_t np_upper)
+{
+    if(np_upper <= p->np_upper) return;
+
+    #define GROW(f, field) \
+    if(HAS(p->attributes, f)) { \
+        void * ptr = fastpm_memory_realloc(p->mem, p->field, sizeof(p->field[0]) * np_upper); \
+        if(ptr == NULL) { \
+            fastpm_raise(-1, "Cannot grow the store from %td to %td particles; increase the allocation factor.\n", \
+                p->np_upper, np_upper); \
+        } \
+        p->field = ptr; \
+    }
+    GROW(PACK_POS, x)
+    GROW(PACK_POS_FIXED, xfixed)
+    GROW(PACK_Q, q)
+    GROW(PACK_VEL, v)
+    GROW(PACK_ACC, acc)
+    GROW(PACK_DX1, dx1)
+    GROW(PACK_DX2, dx2)
+    GROW(PACK_AEMIT, aemit)
+    GROW(PACK_DENSITY, rho)
+    GROW(PACK_POTENTIAL, potential)
+    GROW(PACK_TIDAL, tidal)
+    GROW(PACK_ID, id)
+    #undef GROW
+
+    p->np_upper = np_upper;
+}
+
 size_t
 fastpm_store_get_np_total(FastPMStore * p, MPI_Comm comm)
 {
@@ -390,6 +487,8 @@ fastpm_store_destroy(FastPMStore * p)
         fastpm_memory_free(p->mem, p->id);
     if(p->attributes & PACK_VEL)
         fastpm_memory_free(p->mem, p->v);
+    if(p->attributes & PACK_POS_FIXED)
+        fastpm_memory_free(p->mem, p->xfixed);
     if(p->attributes & PACK_POS)
         fastpm_memory_free(p->mem, p->x);
     if(p->attributes & PACK_Q)
@@ -404,76 +503,286 @@ void fastpm_store_write(FastPMStore * p, char * datasource) {
     /* parse data soure and write */
 }
 
-static void permute(void * data, int np, size_t elsize, int * ind) {
-    void * tmp = malloc(elsize * np);
-    if(!tmp) {
-        fastpm_raise(-1, "No memory for permuting\n");
-    }
-    int i;
-    for(i = 0; i < np; i ++) {
-        memcpy(((char*) tmp) + i * elsize, ((char*) data) + ind[i] * elsize, elsize);
+/* the allocated columns of the attributes, in the order of pack */
+struct StoreColumn {
+    char * data;
+    size_t elsize;
+};
+
+static int
+_store_columns(FastPMStore * p, enum FastPMPackFields attributes, struct StoreColumn * columns)
+{
+    int n = 0;
+    #define COLUMN(f, field) \
+    if(HAS(attributes, f) && p->field) { \
+        columns[n].data = (char*) p->field; \
+        columns[n].elsize = sizeof(p->field[0]); \
+        n ++; \
     }
-    memcpy(data, tmp, np * elsize);
-    free(tmp);
+    COLUMN(PACK_POS, x)
+    COLUMN(PACK_POS_FIXED, xfixed)
+    COLUMN(PACK_VEL, v)
+    COLUMN(PACK_ID, id)
+    COLUMN(PACK_DENSITY, rho)
+    COLUMN(PACK_POTENTIAL, potential)
+    COLUMN(PACK_DX1, dx1)
+    COLUMN(PACK_DX2, dx2)
+    COLUMN(PACK_Q, q)
+    COLUMN(PACK_AEMIT, aemit)
+    COLUMN(PACK_ACC, acc)
+    COLUMN(PACK_TIDAL, tidal)
+    #undef COLUMN
+    return n;
 }
 
+/* permute the columns of the attributes in place */
 static void fastpm_store_permute(FastPMStore * p, int * ind) {
-    if(p->x)
-        permute(p->x, p->np, sizeof(p->x[0]), ind);
-    if(p->v)
-        permute(p->v, p->np, sizeof(p->v[0]), ind);
-    if(p->id)
-        permute(p->id, p->np, sizeof(p->id[0]), ind);
-    if(p->potential)
-        permute(p->potential, p->np, sizeof(p->potential[0]), ind);
-    if(p->tidal)
-        permute(p->tidal, p->np, sizeof(p->tidal[0]), ind);
-    if(p->aemit)
-        permute(p->aemit, p->np, sizeof(p->aemit[0]), ind);
-    if(p->q)
-        permute(p->q, p->np, sizeof(p->q[0]), ind);
-    if(p->acc)
-        permute(p->acc, p->np, sizeof(p->acc[0]), ind);
-    if(p->dx1)
-        permute(p->dx1, p->np, sizeof(p->dx1[0]), ind);
-    if(p->dx2)
-        permute(p->dx2, p->np, sizeof(p->dx2[0]), ind);
-}
-
-static int * __sort_by_id_arg;
-static FastPMStore *  __sort_by_id_p;
-int _sort_by_id_cmpfunc(const void * p1, const void * p2)
+    struct StoreColumn columns[16];
+    int ncolumns = _store_columns(p, p->attributes, columns);
+    void * data[16];
+    size_t elsize[16];
+    int c;
+    for(c = 0; c < ncolumns; c ++) {
+        data[c] = columns[c].data;
+        elsize[c] = columns[c].elsize;
+    }
+    fastpm_permute(data, elsize, ncolumns, p->np, ind, p->mem);
+}
+
+/* spread the lowest 21 bits of x to every third bit */
+static uint64_t
+_morton_spread(uint64_t x)
 {
-    const int * i1 = (const int*) p1;
-    const int * i2 = (const int*) p2;
-    
-    int v1 = (__sort_by_id_p->id[*i1] < __sort_by_id_p->id[*i2]);
-    int v2 = (__sort_by_id_p->id[*i1] > __sort_by_id_p->id[*i2]);
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x001f00000000ffffULL;
+    x = (x | x << 16) & 0x001f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+}
 
-    return v2 - v1;
+/* the Morton key of the mesh cell of particle i */
+static uint64_t
+_cell_key(FastPMStore * p, ptrdiff_t i, PM * pm)
+{
+    double pos[3];
+    p->get_position(p, i, pos);
+    uint64_t key = 0;
+    int d;
+    for(d = 0; d < 3; d ++) {
+        ptrdiff_t ipos = floor(pos[d] * pm->InvCellSize[d]);
+        ipos %= pm->Nmesh[d];
+        if(ipos < 0) ipos += pm->Nmesh[d];
+        key |= _morton_spread(ipos) << (2 - d);
+    }
+    return key;
 }
 
-void fastpm_store_sort_by_id(FastPMStore * p)
+struct SortKey {
+    uint64_t key;
+    int index;
+};
+
+/* A stable LSD radix sort of the lowest nbits of the keys, with 8 bits per pass.
+ * Returns keys or tmp, whichever holds the result. */
+static struct SortKey *
+_radix_sort_keys(struct SortKey * keys, struct SortKey * tmp, ptrdiff_t n, int nbits)
 {
+#ifdef _OPENMP
+    int MaxThreads = omp_get_max_threads();
+#else
+    int MaxThreads = 1;
+#endif
+    ptrdiff_t * count = malloc(sizeof(count[0]) * 256 * MaxThreads);
+    struct SortKey * result = keys;
+
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+        int nth = omp_get_num_threads();
+        int ith = omp_get_thread_num();
+#else
+        int nth = 1;
+        int ith = 0;
+#endif
+        ptrdiff_t start = ith * n / nth;
+        ptrdiff_t end = (ith + 1) * n / nth;
+        ptrdiff_t * mycount = count + 256 * ith;
+        struct SortKey * src = keys;
+        struct SortKey * dst = tmp;
+        int shift;
+        ptrdiff_t i;
+
+        for(shift = 0; shift < nbits; shift += 8) {
+            memset(mycount, 0, sizeof(mycount[0]) * 256);
+            for(i = start; i < end; i ++) {
+                mycount[(src[i].key >> shift) & 255] ++;
+            }
+#pragma omp barrier
+#pragma omp single
+            {
+                /* ordered by digit then thread, which keeps the sort stable */
+                int b, t;
+                ptrdiff_t offset = 0;
+                for(b = 0; b < 256; b ++) {
+                    for(t = 0; t < nth; t ++) {
+                        ptrdiff_t k = count[256 * t + b];
+                        count[256 * t + b] = offset;
+                        offset += k;
+                    }
+                }
+            }
+            for(i = start; i < end; i ++) {
+                dst[mycount[(src[i].key >> shift) & 255] ++] = src[i];
+            }
+#pragma omp barrier
+            struct SortKey * t = src;
+            src = dst;
+            dst = t;
+        }
+#pragma omp single
+        result = src;
+    }
+    free(count);
+    return result;
+}
+
+void
+fastpm_store_sort_by_cell(FastPMStore * p, PM * pm)
+{
+    /* the number of bits of the key */
+    int nbits = 0;
+    int d;
+    for(d = 0; d < 3; d ++) {
+        while((1L << nbits) < pm->Nmesh[d]) nbits ++;
+    }
+    if(nbits > 21) {
+        fastpm_raise(-1, "The mesh of %td cells is too large for sorting by cells.\n", pm->Nmesh[0]);
+    }
+    nbits *= 3;
+
+    struct SortKey * keys = fastpm_memory_alloc(p->mem, sizeof(keys[0]) * p->np, FASTPM_MEMORY_HEAP);
+    struct SortKey * tmp = fastpm_memory_alloc(p->mem, sizeof(tmp[0]) * p->np, FASTPM_MEMORY_HEAP);
+
+    ptrdiff_t i;
+#pragma omp parallel for
+    for(i = 0; i < p->np; i ++) {
+        keys[i].key = _cell_key(p, i, pm);
+        keys[i].index = i;
+    }
+
+    struct SortKey * sorted = _radix_sort_keys(keys, tmp, p->np, nbits);
+
     int * arg = fastpm_memory_alloc(p->mem, sizeof(int) * p->np, FASTPM_MEMORY_HEAP);
-    int i;
+#pragma omp parallel for
     for(i = 0; i < p->np; i ++) {
-        arg[i] = i;
+        arg[i] = sorted[i].index;
     }
-    /* FIXME: copy some version of qsort_r */
-    __sort_by_id_arg = arg;
-    __sort_by_id_p = p;
-    qsort(arg, p->np, sizeof(arg[0]), _sort_by_id_cmpfunc);
     fastpm_store_permute(p, arg);
     fastpm_memory_free(p->mem, arg);
+    fastpm_memory_free(p->mem, tmp);
+    fastpm_memory_free(p->mem, keys);
+}
+
+/* Sort by the id. A dense range of np distinct ids, e.g. the grid of a fresh
+ * run, is placed directly; otherwise the ids relative to the minimum are radix sorted. */
+void
+fastpm_store_sort_by_id(FastPMStore * p)
+{
+    if(p->np == 0) return;
+
+    ptrdiff_t i;
+    uint64_t idmin = UINT64_MAX;
+    uint64_t idmax = 0;
+
+#pragma omp parallel for reduction(min: idmin) reduction(max: idmax)
+    for(i = 0; i < p->np; i ++) {
+        if(p->id[i] < idmin) idmin = p->id[i];
+        if(p->id[i] > idmax) idmax = p->id[i];
+    }
+
+    int * arg = fastpm_memory_alloc(p->mem, sizeof(int) * p->np, FASTPM_MEMORY_HEAP);
+
+    int dense = (idmax - idmin == p->np - 1);
+    if(dense) {
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            arg[i] = -1;
+        }
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            arg[p->id[i] - idmin] = i;
+        }
+        /* a repeated id leaves a hole */
+#pragma omp parallel for reduction(&&: dense)
+        for(i = 0; i < p->np; i ++) {
+            dense = dense && (arg[i] >= 0);
+        }
+    }
+
+    if(!dense) {
+        int nbits = 0;
+        while(nbits < 64 && ((idmax - idmin) >> nbits) != 0) nbits ++;
+
+        struct SortKey * keys = fastpm_memory_alloc(p->mem, sizeof(keys[0]) * p->np, FASTPM_MEMORY_HEAP);
+        struct SortKey * tmp = fastpm_memory_alloc(p->mem, sizeof(tmp[0]) * p->np, FASTPM_MEMORY_HEAP);
+
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            keys[i].key = p->id[i] - idmin;
+            keys[i].index = i;
+        }
+
+        struct SortKey * sorted = _radix_sort_keys(keys, tmp, p->np, nbits);
+
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            arg[i] = sorted[i].index;
+        }
+        fastpm_memory_free(p->mem, tmp);
+        fastpm_memory_free(p->mem, keys);
+    }
+
+    fastpm_store_permute(p, arg);
+    fastpm_memory_free(p->mem, arg);
+}
+
+double
+fastpm_store_cell_locality(FastPMStore * p, PM * pm)
+{
+    ptrdiff_t n = 0;
+    ptrdiff_t i;
+#pragma omp parallel for reduction(+: n)
+    for(i = 1; i < p->np; i ++) {
+        double pos1[3], pos2[3];
+        p->get_position(p, i - 1, pos1);
+        p->get_position(p, i, pos2);
+        int d;
+        int near = 1;
+        for(d = 0; d < 3; d ++) {
+            ptrdiff_t dx = floor(pos2[d] * pm->InvCellSize[d]) - floor(pos1[d] * pm->InvCellSize[d]);
+            /* periodic */
+            dx %= pm->Nmesh[d];
+            if(dx < 0) dx += pm->Nmesh[d];
+            if(dx > 1 && dx < pm->Nmesh[d] - 1) near = 0;
+        }
+        n += near;
+    }
+    if(p->np < 2) return 1.0;
+    return 1.0 * n / (p->np - 1);
 }
 
 void 
 fastpm_store_wrap(FastPMStore * p, double BoxSize[3])
 {
-    int i;
-    int d;
+    /* the fixed point positions are always in the box */
+    if(!p->x) return;
+
+    ptrdiff_t i;
+#pragma omp parallel for
     for(i = 0; i < p->np; i ++) {
+        int d;
         for(d = 0; d < 3; d ++) {
             while(p->x[i][d] < 0) p->x[i][d] += BoxSize[d];
             while(p->x[i][d] >= BoxSize[d]) p->x[i][d] -= BoxSize[d];
@@ -490,65 +799,204 @@ FastPMTargetPM (FastPMStore * p, ptrdiff_t i, PM * pm)
 }
 
 
-void
-fastpm_store_decompose(FastPMStore * p,
+/* same as pm_pos_to_rank(pm, pos) == pm->ThisTask for positions in the local region,
+ * without the lookup of the rank. */
+static inline int
+_in_local_region(FastPMStore * p, ptrdiff_t i, PM * pm)
+{
+    double pos[3];
+    p->get_position(p, i, pos);
+    int d;
+    for(d = 0; d < 2; d ++) {
+        double t = pos[d] * pm->InvCellSize[d];
+        if(t < pm->IRegion.start[d]
+        || t >= pm->IRegion.start[d] + pm->IRegion.size[d]) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Particles that leave the rank are packed straight from the store; the
+ * particles at the tail of the store that stay are then moved into their
+ * slots, such that the store is partitioned without a permutation.
+ *
+ * The targets are evaluated twice, once to count and once to list the
+ * leavers; only the leavers are recorded, so the memory is proportional
+ * to the number of leavers. target_func is called from several threads.
+ *
+ * The send buffer holds for each rank the columns one after another,
+ * such that the received particles are unpacked with one copy per column
+ * and rank.
+ *
+ * If local is given, the particles in the local region of local are kept
+ * without calling target_func.
+ * */
+static void
+_store_decompose(FastPMStore * p,
     fastpm_store_target_func target_func,
-    void * data, MPI_Comm comm)
+    void * data, PM * local, MPI_Comm comm)
 {
-    int * target = fastpm_memory_alloc(p->mem, sizeof(int) * p->np, FASTPM_MEMORY_HEAP);
     int NTask, ThisTask;
 
     MPI_Comm_rank(comm, &ThisTask);
     MPI_Comm_size(comm, &NTask);
 
-    ptrdiff_t i;
-    for(i = 0; i < p->np; i ++) {
-        target[i] = target_func(p, i, data);
-        if(ThisTask == target[i]) {
-            target[i] = 0;
-        } else {
-            target[i] ++;
-        }
+#ifdef _OPENMP
+    int MaxThreads = omp_get_max_threads();
+#else
+    int MaxThreads = 1;
+#endif
+
+    struct StoreColumn columns[16];
+    int ncolumns = _store_columns(p, p->attributes, columns);
+    size_t coloffset[16];
+    size_t elsize = 0;
+    int c;
+    for(c = 0; c < ncolumns; c ++) {
+        coloffset[c] = elsize;
+        elsize += columns[c].elsize;
     }
-    /* do a bincount; offset by -1 because -1 is for self */
-    int * count = calloc(NTask + 1, sizeof(int));
-    int * offsets = calloc(NTask + 1, sizeof(int));
-    int * sendcount = count + 1;
-    int * recvcount = malloc(sizeof(int) * (NTask));
-    int * recvoffset = malloc(sizeof(int) * (NTask));
-    int * sendoffset = malloc(sizeof(int) * (NTask));
 
-    for(i = 0; i < p->np; i ++) {
-        count[target[i]] ++;
-    }
-    cumsum(offsets, count, NTask + 1);
+    /* leavers of each thread, and the per-thread histogram of their targets */
+    ptrdiff_t * leavestart = calloc(MaxThreads + 1, sizeof(ptrdiff_t));
+    int * count = calloc((size_t) NTask * MaxThreads, sizeof(int));
+
+    int * sendcount = calloc(NTask, sizeof(int));
+    int * sendoffset = malloc(sizeof(int) * NTask);
+    int * recvcount = malloc(sizeof(int) * NTask);
+    int * recvoffset = malloc(sizeof(int) * NTask);
+
+    ptrdiff_t * leaver = NULL;
+    int * target = NULL;
+    int * slot = NULL;
+    size_t Nleave = 0;
+
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+        int nth = omp_get_num_threads();
+        int ith = omp_get_thread_num();
+#else
+        int nth = 1;
+        int ith = 0;
+#endif
+        ptrdiff_t start = ith * p->np / nth;
+        ptrdiff_t end = (ith + 1) * p->np / nth;
+        int * mycount = count + (size_t) ith * NTask;
+        ptrdiff_t i;
+        ptrdiff_t n = 0;
+
+        for(i = start; i < end; i ++) {
+            if(local && _in_local_region(p, i, local)) continue;
+            if(target_func(p, i, data) != ThisTask) n ++;
+        }
+        leavestart[ith + 1] = n;
+
+#pragma omp barrier
+#pragma omp single
+        {
+            int t;
+            for(t = 0; t < nth; t ++) {
+                leavestart[t + 1] += leavestart[t];
+            }
+            Nleave = leavestart[nth];
+            leaver = fastpm_memory_alloc(p->mem, sizeof(leaver[0]) * Nleave, FASTPM_MEMORY_HEAP);
+            target = fastpm_memory_alloc(p->mem, sizeof(target[0]) * Nleave, FASTPM_MEMORY_HEAP);
+            slot = fastpm_memory_alloc(p->mem, sizeof(slot[0]) * Nleave, FASTPM_MEMORY_HEAP);
+        }
 
-    int * arg = fastpm_memory_alloc(p->mem, sizeof(int) * p->np, FASTPM_MEMORY_HEAP);
-    for(i = 0; i < p->np; i ++) {
-        int offset = offsets[target[i]] ++;
-        arg[offset] = i;
-    }
-    fastpm_store_permute(p, arg);
+        n = leavestart[ith];
+        for(i = start; i < end; i ++) {
+            if(local && _in_local_region(p, i, local)) continue;
+            int t = target_func(p, i, data);
+            if(t == ThisTask) continue;
+            leaver[n] = i;
+            target[n] = t;
+            mycount[t] ++;
+            n ++;
+        }
 
-    fastpm_memory_free(p->mem, arg);
-    fastpm_memory_free(p->mem, target);
+#pragma omp barrier
+#pragma omp single
+        {
+            /* turn the histograms into the slots of the threads, ordered by rank then thread */
+            int r, t;
+            int offset = 0;
+            for(r = 0; r < NTask; r ++) {
+                sendoffset[r] = offset;
+                for(t = 0; t < nth; t ++) {
+                    int k = count[(size_t) t * NTask + r];
+                    count[(size_t) t * NTask + r] = offset;
+                    offset += k;
+                }
+                sendcount[r] = offset - sendoffset[r];
+            }
+        }
 
-    MPI_Alltoall(sendcount, 1, MPI_INT, 
-                 recvcount, 1, MPI_INT, 
+        for(n = leavestart[ith]; n < leavestart[ith + 1]; n ++) {
+            slot[n] = mycount[target[n]] ++;
+        }
+    }
+
+    MPI_Alltoall(sendcount, 1, MPI_INT,
+                 recvcount, 1, MPI_INT,
                  comm);
 
-    size_t Nsend = cumsum(sendoffset, sendcount, NTask);
+    size_t Nsend = Nleave;
     size_t Nrecv = cumsum(recvoffset, recvcount, NTask);
-    size_t elsize = p->pack(p, 0, NULL, p->attributes);
 
-    void * send_buffer = fastpm_memory_alloc(p->mem, elsize * Nsend, FASTPM_MEMORY_HEAP);
-    void * recv_buffer = fastpm_memory_alloc(p->mem, elsize * Nrecv, FASTPM_MEMORY_HEAP);
+    if(p->np - Nsend + Nrecv > p->np_upper) {
+        /* grow by at least an eighth, such that the store is not relocated on every step */
+        size_t np_upper = p->np_upper + p->np_upper / 8;
+        if(np_upper < p->np - Nsend + Nrecv) np_upper = p->np - Nsend + Nrecv;
+        fastpm_store_reserve(p, np_upper);
+        _store_columns(p, p->attributes, columns);
+    }
 
-    p->np -= Nsend;
-    for(i = 0; i < Nsend; i ++) {
-        p->pack(p, i + p->np, (char*) send_buffer + i * elsize, p->attributes);
+    char * send_buffer = fastpm_memory_alloc(p->mem, elsize * Nsend, FASTPM_MEMORY_HEAP);
+
+    ptrdiff_t n;
+    for(c = 0; c < ncolumns; c ++) {
+        size_t size = columns[c].elsize;
+#pragma omp parallel for
+        for(n = 0; n < Nsend; n ++) {
+            int r = target[n];
+            char * seg = send_buffer + (size_t) sendoffset[r] * elsize + (size_t) sendcount[r] * coloffset[c];
+            memcpy(seg + (slot[n] - sendoffset[r]) * size, columns[c].data + leaver[n] * size, size);
+        }
+    }
+
+    /* move the stayers in the tail to the slots of the leavers in the head. leaver is
+     * ascending, so the leavers in the tail are the last ones. */
+    ptrdiff_t tail = p->np - Nsend;
+    ptrdiff_t nholes = 0;
+    while(nholes < Nsend && leaver[nholes] < tail) nholes ++;
+
+    ptrdiff_t * stayer = fastpm_memory_alloc(p->mem, sizeof(stayer[0]) * nholes, FASTPM_MEMORY_HEAP);
+    {
+        ptrdiff_t i = tail;
+        ptrdiff_t k = nholes;
+        ptrdiff_t s = 0;
+        for(; s < nholes; i ++) {
+            if(k < Nsend && leaver[k] == i) {
+                k ++;
+                continue;
+            }
+            stayer[s++] = i;
+        }
     }
+    for(c = 0; c < ncolumns; c ++) {
+        size_t size = columns[c].elsize;
+#pragma omp parallel for
+        for(n = 0; n < nholes; n ++) {
+            memcpy(columns[c].data + leaver[n] * size, columns[c].data + stayer[n] * size, size);
+        }
+    }
+    fastpm_memory_free(p->mem, stayer);
 
+    p->np -= Nsend;
+
+    char * recv_buffer = fastpm_memory_alloc(p->mem, elsize * Nrecv, FASTPM_MEMORY_HEAP);
 
     MPI_Datatype PTYPE;
     MPI_Type_contiguous(elsize, MPI_BYTE, &PTYPE);
@@ -559,20 +1007,49 @@ fastpm_store_decompose(FastPMStore * p,
             comm);
     MPI_Type_free(&PTYPE);
 
-    for(i = 0; i < Nrecv; i ++) {
-        p->unpack(p, i + p->np, (char*) recv_buffer + i * elsize, p->attributes);
+    int r;
+#pragma omp parallel for private(c) schedule(dynamic, 1)
+    for(r = 0; r < NTask; r ++) {
+        if(recvcount[r] == 0) continue;
+        for(c = 0; c < ncolumns; c ++) {
+            size_t size = columns[c].elsize;
+            memcpy(columns[c].data + (p->np + recvoffset[r]) * size,
+                   recv_buffer + (size_t) recvoffset[r] * elsize + (size_t) recvcount[r] * coloffset[c],
+                   (size_t) recvcount[r] * size);
+        }
     }
 
     p->np += Nrecv;
 
     fastpm_memory_free(p->mem, recv_buffer);
     fastpm_memory_free(p->mem, send_buffer);
+    fastpm_memory_free(p->mem, slot);
+    fastpm_memory_free(p->mem, target);
+    fastpm_memory_free(p->mem, leaver);
 
-    free(recvcount);
     free(recvoffset);
+    free(recvcount);
     free(sendoffset);
-    free(offsets);
+    free(sendcount);
     free(count);
+    free(leavestart);
+}
+
+void
+fastpm_store_decompose(FastPMStore * p,
+    fastpm_store_target_func target_func,
+    void * data, MPI_Comm comm)
+{
+    _store_decompose(p, target_func, data, NULL, comm);
+}
+
+/* Between two steps most particles stay in the local region of pm; only
+ * those outside are looked up, such that the cost scales with the number
+ * of particles that cross the edges of the region rather than with np. */
+void
+fastpm_store_decompose_pm(FastPMStore * p, PM * pm, MPI_Comm comm)
+{
+    _store_decompose(p, (fastpm_store_target_func) FastPMTargetPM, pm, pm, comm);
 }
 
 void 
@@ -584,15 +1061,18 @@ fastpm_store_set_lagrangian_position(FastPMStore * p, PM * pm, double * shift, p
         Nc = pm_nmesh(pm);
     }
     int d;
+    for(d = 0; d < 3; d++) {
+        p->lagrangian.Nc[d] = Nc[d];
+        p->lagrangian.CellSize[d] = pm->BoxSize[d] / Nc[d];
+        p->lagrangian.shift[d] = shift ? shift[d] : 0;
+    }
     p->np = 1;
     for(d = 0; d < 3; d++) {
         int start = pm->IRegion.start[d] * Nc[d] / pm->Nmesh[d];
         int end = (pm->IRegion.start[d] + pm->IRegion.size[d]) * Nc[d] / pm->Nmesh[d];
         p->np *= end - start;
     }
-    if(p->np > p->np_upper) {
-        fastpm_raise(-1, "Need %td particles; %td allocated\n", p->np, p->np_upper);
-    }
+    fastpm_store_reserve(p, p->np);
     ptrdiff_t ptr = 0;
 
     PMXIter iter;
@@ -615,16 +1095,18 @@ fastpm_store_set_lagrangian_position(FastPMStore * p, PM * pm, double * shift, p
 
             id = ii * Nc[1] * Nc[2] + jj * Nc[2] + kk;
 
+            double pos[3];
             for(d = 0; d < 3; d ++) {
-                p->x[ptr][d] = pabs[d] * (pm->BoxSize[d] / Nc[d]);
+                pos[d] = pabs[d] * (pm->BoxSize[d] / Nc[d]);
 
-                if(shift) p->x[ptr][d] += shift[d];
+                if(shift) pos[d] += shift[d];
 
                 if(p->id) p->id[ptr]  = id;
 
                 /* set q if it is allocated. */
-                if(p->q) p->q[ptr][d] = p->x[ptr][d];
+                if(p->q) p->q[ptr][d] = pos[d];
             }
+            fastpm_store_set_position(p, ptr, pos);
             ptr ++;
         }
     }
@@ -677,11 +1159,31 @@ fastpm_store_summary(FastPMStore * p, double dx1[3], double dx2[3], MPI_Comm com
 void
 fastpm_store_copy(FastPMStore * p, FastPMStore * po)
 {
-    if(p->np > po->np_upper) {
-        fastpm_raise(-1, "Not enough storage in target FastPMStore: asking for %td but has %td\n", p->np, po->np_upper);
+    fastpm_store_reserve(po, p->np);
+    if(po->x && p->x) memcpy(po->x, p->x, sizeof(p->x[0][0]) * 3 * p->np);
+    if(po->xfixed && p->xfixed) memcpy(po->xfixed, p->xfixed, sizeof(p->xfixed[0][0]) * 3 * p->np);
+    if((po->x || po->xfixed) && po->get_position != p->get_position) {
+        ptrdiff_t i;
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            double pos[3];
+            p->get_position(p, i, pos);
+            fastpm_store_set_position(po, i, pos);
+        }
+    }
+    if(po->q && p->q) memcpy(po->q, p->q, sizeof(p->q[0][0]) * 3 * p->np);
+    if(po->q && !p->q) {
+        ptrdiff_t i;
+#pragma omp parallel for
+        for(i = 0; i < p->np; i ++) {
+            double q[3];
+            fastpm_store_get_lagrangian_position(p, i, q);
+            int d;
+            for(d = 0; d < 3; d ++) {
+                po->q[i][d] = q[d];
+            }
+        }
     }
-    if(po->x) memcpy(po->x, p->x, sizeof(p->x[0][0]) * 3 * p->np);
-    if(po->q) memcpy(po->q, p->q, sizeof(p->q[0][0]) * 3 * p->np);
     if(po->v) memcpy(po->v, p->v, sizeof(p->v[0][0]) * 3 * p->np);
     if(po->acc) memcpy(po->acc, p->acc, sizeof(p->acc[0][0]) * 3 * p->np);
     if(po->dx1) memcpy(po->dx1, p->dx1, sizeof(p->dx1[0][0]) * 3 * p->np);
@@ -692,6 +1194,7 @@ fastpm_store_copy(FastPMStore * p, FastPMStore * po)
     if(po->rho) memcpy(po->rho, p->rho, sizeof(p->potential[0]) * p->np);
     if(po->tidal) memcpy(po->tidal, p->tidal, sizeof(p->tidal[0]) * p->np);
 
+    po->lagrangian = p->lagrangian;
     po->np = p->np;
     po->a_x = p->a_x;
     po->a_v = p->a_v;
@@ -703,6 +1206,7 @@ fastpm_store_create_subsample(FastPMStore * po, FastPMStore * p, int mod, int nc
 {
     ptrdiff_t i;
     ptrdiff_t j;
+    int d;
     j = 0;
 
     for(i = 0; i < p->np; i ++) {
@@ -716,8 +1220,18 @@ fastpm_store_create_subsample(FastPMStore * po, FastPMStore * p, int mod, int nc
         id /= nc;
         if((id % nc) % mod != 0) continue;
 
-        if(po->x) memcpy(po->x[j], p->x[i], sizeof(p->x[0][0]) * 3);
-        if(po->q) memcpy(po->q[j], p->q[i], sizeof(p->q[0][0]) * 3);
+        if(po->x || po->xfixed) {
+            double pos[3];
+            p->get_position(p, i, pos);
+            fastpm_store_set_position(po, j, pos);
+        }
+        if(po->q) {
+            double q[3];
+            fastpm_store_get_lagrangian_position(p, i, q);
+            for(d = 0; d < 3; d ++) {
+                po->q[j][d] = q[d];
+            }
+        }
         if(po->v) memcpy(po->v[j], p->v[i], sizeof(p->v[0][0]) * 3);
         if(po->acc) memcpy(po->acc[j], p->acc[i], sizeof(p->acc[0][0]) * 3);
         if(po->dx1) memcpy(po->dx1[j], p->dx1[i], sizeof(p->dx1[0][0]) * 3);
@@ -728,6 +1242,7 @@ fastpm_store_create_subsample(FastPMStore * po, FastPMStore * p, int mod, int nc
         if(po->tidal) memcpy(po->tidal[j], p->tidal[i], sizeof(p->tidal[0][0]) * 6);
         j ++;
     }
+    po->lagrangian = p->lagrangian;
     po->np = j; 
     po->a_x = p->a_x;
     po->a_v = p->a_v;
@@ -56,7 +56,7 @@ fastpm_utils_paint(PM * pm, FastPMStore * p,
     if(get_position == NULL) {
         get_position = p->get_position;
     }
-    PMGhostData * pgd = pm_ghosts_create(pm, p, p->attributes, get_position);
+    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS | attribute, 0, get_position);
 
     fastpm_painter_init(&painter, pm, FASTPM_PAINTER_CIC, 1);
 
@@ -64,7 +64,7 @@ fastpm_utils_paint(PM * pm, FastPMStore * p,
      * otherwise increase this to (Nmesh / Ngrid) **3 */
     FastPMFloat * canvas = pm_alloc(pm);
 
-    fastpm_paint_local(&painter, canvas, p, p->np + pgd->nghosts, get_position, attribute);
+    pm_ghosts_paint(pgd, &painter, canvas, attribute);
 
     if(delta_x)
         pm_assign(pm, canvas, delta_x);
@@ -89,12 +89,12 @@ fastpm_utils_readout(PM * pm, FastPMStore * p,
         get_position = p->get_position;
     }
 
-    PMGhostData * pgd = pm_ghosts_create(pm, p, p->attributes, get_position);
+    PMGhostData * pgd = pm_ghosts_create(pm, p, PACK_POS, attribute, get_position);
 
     fastpm_painter_init(&painter, pm,
                 FASTPM_PAINTER_CIC, 1);
 
-    fastpm_readout_local(&painter, delta_x, p, p->np + pgd->nghosts, get_position, attribute);
+    pm_ghosts_readout_multi(pgd, &painter, &delta_x, 1, &attribute);
 
     pm_ghosts_reduce(pgd, attribute);
     pm_ghosts_free(pgd);
@@ -2,6 +2,7 @@
 #include <mpi.h>
 
 #include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
 #include "pmpfft.h"
 #include "vpm.h"
 
@@ -38,7 +39,25 @@ vpm_create (VPMInit * vpminit, PMInit * baseinit, MPI_Comm comm)
 
         PMInit pminit = *baseinit;
         pminit.Nmesh = baseinit->Nmesh * vpm[i].pm_nc_factor;
+        pminit.fft_precision = vpminit[i].precision;
+        if(pminit.autotune) {
+            /* tune once per Nmesh; the later meshes keep the process mesh
+             * of the first, such that the pencils of all PMs agree. */
+            int j;
+            for(j = 0; j < i; j ++) {
+                if(vpm[j].pm.init.Nmesh == pminit.Nmesh) break;
+            }
+            if(j < i) {
+                pminit.NprocY = vpm[j].pm.Nproc[1];
+                pminit.fft_threads = vpm[j].pm.init.fft_threads;
+                pminit.autotune = 0;
+            } else if(i > 0) {
+                pminit.NprocY = vpm[0].pm.Nproc[1];
+            }
+        }
         pm_init(&vpm[i].pm, &pminit, comm);
+        fastpm_info("VPM %d of Nmesh %td: process mesh %d x %d, %d FFT threads\n",
+            i, vpm[i].pm.init.Nmesh, vpm[i].pm.Nproc[0], vpm[i].pm.Nproc[1], vpm[i].pm.init.fft_threads);
     }
     /* the end of the list */
     vpm[i].end = 1;
@@ -29,9 +29,11 @@
 
 typedef struct {
     int UseFFTW;
+    int TuneFFT;
     int NprocY;
     int Nwriters;
     size_t MemoryPerRank;
+    char * WisdomFile;
     LuaConfig * config;
     char * string;
 } Parameters;
@@ -98,7 +100,10 @@ int main(int argc, char ** argv) {
 
     fastpm_info("This is FastPM, with libfastpm version %s.\n", LIBFASTPM_VERSION);
 
-    libfastpm_set_memory_bound(prr->MemoryPerRank * 1024 * 1024, 0);
+    libfastpm_set_memory_bound(prr->MemoryPerRank * 1024 * 1024, 1);
+    if(prr->WisdomFile) {
+        libfastpm_import_fft_wisdom(prr->WisdomFile, comm);
+    }
     read_parameters(ParamFileName, prr, argc, argv, comm);
 
     /* convert parameter files pm_nc_factor into VPMInit */
@@ -110,11 +115,17 @@ int main(int argc, char ** argv) {
             };
     } else
     if(CONF(prr, ndim_pm_nc_factor) == 2) {
+        /* {a, factor} or {a, factor, FFT precision} */
+        int ncol = CONF(prr, shape_pm_nc_factor)[1];
+        if(ncol != 2 && ncol != 3) {
+            fastpm_raise(-1, "The rows of pm_nc_factor are either {a, factor} or {a, factor, precision}. ");
+        }
         vpminit = alloca(sizeof(VPMInit) * (CONF(prr, shape_pm_nc_factor)[0] + 1));
         int i;
         for(i = 0; i < CONF(prr, n_pm_nc_factor); i ++) {
-            vpminit[i].a_start = CONF(prr, pm_nc_factor)[2 * i];
-            vpminit[i].pm_nc_factor = CONF(prr, pm_nc_factor)[2 * i + 1];
+            vpminit[i].a_start = CONF(prr, pm_nc_factor)[ncol * i];
+            vpminit[i].pm_nc_factor = CONF(prr, pm_nc_factor)[ncol * i + 1];
+            vpminit[i].precision = (ncol == 3) ? CONF(prr, pm_nc_factor)[ncol * i + 2] : 0;
         }
         /* mark the end */
         vpminit[i].pm_nc_factor = 0;
@@ -139,8 +150,16 @@ int main(int argc, char ** argv) {
         .DEALIASING_TYPE = CONF(prr, dealiasing_type),
         .PAINTER_TYPE = CONF(prr, painter_type),
         .painter_support = CONF(prr, painter_support),
+        .painter_interlacing = CONF(prr, painter_interlacing),
+        .readout_canvases = CONF(prr, readout_canvases),
+        .mesh_halo = CONF(prr, mesh_halo),
+        .balance_domains = CONF(prr, balance_domains),
+        .fixed_point_positions = CONF(prr, fixed_point_positions),
+        .sort_interval = CONF(prr, sort_interval),
+        .sort_locality = CONF(prr, sort_locality),
         .NprocY = prr->NprocY,
         .UseFFTW = prr->UseFFTW,
+        .TuneFFT = prr->TuneFFT,
         .COMPUTE_POTENTIAL = CONF(prr, compute_potential),
     };
 
@@ -189,6 +208,11 @@ int run_fastpm(FastPMConfig * config, Parameters * prr, MPI_Comm comm) {
 
     fastpm_solver_init(fastpm, config, comm);
 
+    /* all of the FFTs are planned */
+    if(prr->WisdomFile) {
+        libfastpm_export_fft_wisdom(prr->WisdomFile, comm);
+    }
+
     fastpm_info("BaseProcMesh : %d x %d\n",
             pm_nproc(fastpm->basepm)[0], pm_nproc(fastpm->basepm)[1]);
 #ifdef _OPENMP
@@ -244,6 +268,11 @@ int run_fastpm(FastPMConfig * config, Parameters * prr, MPI_Comm comm) {
     fastpm_solver_evolve(fastpm, CONF(prr, time_step), CONF(prr, n_time_step));
     LEAVE(evolve);
 
+    /* the stores grow if the allocation factor is too small; this tells how much was needed */
+    fastpm_info("Peak load imbalance is + %g (np_alloc_factor = %g)\n",
+        fastpm->info.imbalance.peak, CONF(prr, np_alloc_factor));
+    fastpm_info("Peak number of particles on a rank is %td\n", fastpm->info.imbalance.np_peak);
+
     if(CONF(prr, lc_write_usmesh)) {
         long long np = usmesh->p->np;
         MPI_Allreduce(MPI_IN_PLACE, &np, 1, MPI_LONG_LONG, MPI_SUM, comm);
@@ -671,6 +700,10 @@ take_a_snapshot(FastPMSolver * fastpm, FastPMStore * snapshot, double aout, Para
 
         fastpm_painter_init(painter, fastpm->basepm, fastpm->config->PAINTER_TYPE, fastpm->config->painter_support);
 
+        /* the snapshot has drifted since the last decomposition, and the ghosts only reach the neighbours */
+        fastpm_store_wrap(snapshot, pm_boxsize(fastpm->basepm));
+        fastpm_store_decompose_pm(snapshot, fastpm->basepm, fastpm->comm);
+
         fastpm_paint(painter, rho_x, snapshot, NULL, 0);
         pm_r2c(fastpm->basepm, rho_x, rho_k);
 
@@ -865,11 +898,13 @@ parse_args(int * argc, char *** argv, Parameters * prr)
     extern int optind;
     extern char * optarg;
     prr->UseFFTW = 0;
+    prr->TuneFFT = 0;
     ParamFileName = NULL;
     prr->NprocY = 0;
     prr->Nwriters = 0;
     prr->MemoryPerRank = 0;
-    while ((opt = getopt(*argc, *argv, "h?y:fW:m:")) != -1) {
+    prr->WisdomFile = NULL;
+    while ((opt = getopt(*argc, *argv, "h?y:fW:m:w:t")) != -1) {
         switch(opt) {
             case 'y':
                 prr->NprocY = atoi(optarg);
@@ -883,6 +918,12 @@ parse_args(int * argc, char *** argv, Parameters * prr)
             case 'm':
                 prr->MemoryPerRank = atoi(optarg);
             break;
+            case 'w':
+                prr->WisdomFile = optarg;
+            break;
+            case 't':
+                prr->TuneFFT = 1;
+            break;
             case 'h':
             case '?':
             default:
@@ -900,9 +941,11 @@ parse_args(int * argc, char *** argv, Parameters * prr)
     return;
 
 usage:
-    printf("Usage: fastpm [-W Nwriters] [-f] [-y NprocY] [-m MemoryBoundInMB] paramfile\n"
+    printf("Usage: fastpm [-W Nwriters] [-f] [-y NprocY] [-m MemoryBoundInMB] [-w WisdomFile] [-t] paramfile\n"
     "-f Use FFTW \n"
     "-y Set the number of processes in the 2D mesh\n"
+    "-w Measure the FFT plans, reading and updating the wisdom in WisdomFile\n"
+    "-t Time the FFTs on a few process meshes and thread counts; use the fastest\n"
     "-n Throttle IO (bigfile only) \n"
 );
     MPI_Finalize();
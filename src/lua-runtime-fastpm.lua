@@ -35,13 +35,15 @@ end
 
 schema.declare{name='omega_m',           type='number', required=true, default=0.3 }
 schema.declare{name='h',                 type='number', required=true, default=0.7, help="Dimensionless Hubble parameter"}
-schema.declare{name='pm_nc_factor',      type='array:number',  required=true, help="A list of {a, PM resolution}, "}
-schema.declare{name='np_alloc_factor',   type='number', required=true, help="Over allocation factor for load imbalance" }
+schema.declare{name='pm_nc_factor',      type='array:number',  required=true, help="A list of {a, PM resolution}, or of {a, PM resolution, FFT precision} to transform in single precision (32) until the next entry. The FFT precision only has an effect in a build with FASTPM_FFT_PRECISION=64; a single precision build (the default) always transforms in single precision."}
+schema.declare{name='np_alloc_factor',   type='number', required=true, help="Over allocation factor for load imbalance; the particle stores grow beyond it when needed. The peak imbalance of the run is reported at the end." }
 schema.declare{name='compute_potential',   type='boolean', required=false, default=false, help="Calculate the gravitional potential."}
 
 -- Force calculation --
 schema.declare{name='painter_type',        type='enum', default='cic', help="Type of painter."}
 schema.declare{name='painter_support',     type='int', default=2, help="Support (size) of the painting kernel"}
+schema.declare{name='painter_interlacing', type='boolean', default=false,
+        help="Paint the density also on a mesh shifted by half a cell and average the two in Fourier space; suppresses aliasing at twice the painting and r2c cost."}
 schema.painter_type.choices = {
     cic = 'FASTPM_PAINTER_CIC',
     linear = 'FASTPM_PAINTER_LINEAR',
@@ -52,6 +54,18 @@ function schema.painter_type.action(painter_type)
         schema.painter_support.required = true
     end
 end
+schema.declare{name='readout_canvases',    type='int', default=1,
+        help="Number of force meshes kept in memory at once for the readout. More meshes use more memory but share the kernel weights; -1 keeps all. With mesh_halo or balance_domains the weights are not shared."}
+schema.declare{name='mesh_halo',           type='boolean', default=false,
+        help="Paint the particles into a halo around the local mesh and exchange the halo with the neighbours, instead of exchanging ghost particles. The traffic does not grow with clustering."}
+schema.declare{name='balance_domains',     type='boolean', default=false,
+        help="Decompose the particles to domains of equal counts instead of the pencils of the force mesh. The particles are painted into patches that are routed to the pencils; reduces the load imbalance in clustered boxes."}
+schema.declare{name='fixed_point_positions', type='boolean', default=false,
+        help="Store the positions of the particles as 32-bit fixed point fractions of the box instead of double precision, saving 12 bytes per particle. The resolution is 2**-32 of the box."}
+schema.declare{name='sort_interval',       type='int', default=0,
+        help="Sort the particles on each rank by the Morton key of their cells every so many force calculations, for the cache locality of painting and reading out. 0 never sorts."}
+schema.declare{name='sort_locality',       type='number', default=0,
+        help="Sort the particles by cells whenever fewer than this fraction of consecutive particles are in adjacent cells. 0 never sorts."}
 schema.declare{name='force_mode',        type='enum', default='fastpm'}
 schema.force_mode.choices = {
     cola = 'FASTPM_FORCE_COLA',
@@ -165,7 +179,7 @@ schema.declare{name='lc_glmatrix',     type='array:number',
 
 schema.declare{name='za',                      type='boolean', default=false, help='use ZA initial condition not 2LPT'}
 
-schema.declare{name='kernel_type',             type='enum', default="3_4", help='Force kernel; very little effect.'}
+schema.declare{name='kernel_type',             type='enum', default="3_4", help='Force kernel; very little effect. 3_4_fd and 3_6_fd take the gradients in real space, with one inverse FFT per force step.'}
 schema.kernel_type.choices = {
     ['3_4'] = 'FASTPM_KERNEL_3_4',
     ['5_4'] = 'FASTPM_KERNEL_5_4',
@@ -173,6 +187,8 @@ schema.kernel_type.choices = {
     ['gadget'] = 'FASTPM_KERNEL_GADGET',
     ['naive'] = 'FASTPM_KERNEL_NAIVE',
     ['3_2'] = 'FASTPM_KERNEL_3_2',
+    ['3_4_fd'] = 'FASTPM_KERNEL_3_4_FD',
+    ['3_6_fd'] = 'FASTPM_KERNEL_3_6_FD',
 }
 schema.declare{name='dealiasing_type',             type='enum', default="none", help='Dealiasing kernel (wipes out small scale force), very litle effect)'}
 schema.dealiasing_type.choices = {
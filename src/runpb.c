@@ -42,6 +42,10 @@ read_runpb_ic(FastPMSolver * fastpm, FastPMStore * p, const char * filename)
     int NTask = fastpm->NTask;
     MPI_Comm comm = fastpm->comm;
 
+    if(p->x == NULL) {
+        fastpm_raise(-1, "Reading RunPB initial conditions requires double precision positions.\n");
+    }
+
     size_t scratch_bytes = 32 * 1024 * 1024;
     void * scratch = malloc(scratch_bytes);
     float * fscratch = (float*) scratch;
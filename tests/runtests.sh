@@ -8,6 +8,11 @@ FASTPM=`dirname $0`/../src/fastpm
 
 set -x
 
+# with threads for the columns permuted in parallel
+OMP_NUM_THREADS=4 mpirun -n 1 `dirname $0`/testpermute || fail
+mpirun -n 1 `dirname $0`/testgravity || fail
+mpirun -n 4 `dirname $0`/testgravity || fail
+
 mpirun -n 4 $FASTPM standard.lua ic || fail
 
 mpirun -n 4 $FASTPM standard.lua fastpm lineark || fail
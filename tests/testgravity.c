@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+#include <math.h>
+
+#include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
+
+#include "pmpfft.h"
+#include "pmhalo.h"
+
+/*
+ * Plane waves cos(k x + phase) through the force kernels, against the transfer
+ * functions of the kernels, on every process mesh of the ranks:
+ *
+ * - the k-space kernels of gravity_apply_kernel_transfer, for all kernel types;
+ * - the gradients of the real space kernels (3_4_fd, 3_6_fd) taken with the
+ *   central difference on a mesh halo, against the k-space kernels of the same
+ *   order (gradorder 1 and 2).
+ */
+
+static int Modes[][3] = {
+    {1, 2, 3},
+    {3, -1, 2},
+    {7, 5, -6},
+    {0, 0, 11},
+};
+
+static double Phase = 0.3;
+
+typedef struct {
+    FastPMKernelType type;
+    const char * name;
+    int potorder;  /* 0 for k2, 1 for the 3 point and 2 for the 5 point difference */
+    int gradorder; /* 0 for k, 1 for the 4 point and 2 for the 6 point difference */
+    int ndecic;
+} Kernel;
+
+static Kernel Kernels[] = {
+    {FASTPM_KERNEL_3_4, "3_4", 1, 1, 0},
+    {FASTPM_KERNEL_3_2, "3_2", 1, 0, 0},
+    {FASTPM_KERNEL_5_4, "5_4", 2, 1, 0},
+    {FASTPM_KERNEL_GADGET, "gadget", 0, 1, 0},
+    {FASTPM_KERNEL_EASTWOOD, "eastwood", 0, 0, 2},
+    {FASTPM_KERNEL_NAIVE, "naive", 0, 0, 0},
+    {FASTPM_KERNEL_3_4_FD, "3_4_fd", 1, 1, 0},
+    {FASTPM_KERNEL_3_6_FD, "3_6_fd", 1, 2, 0},
+};
+
+typedef struct {
+    enum FastPMPackFields attribute;
+    const char * name;
+    int potential;
+    int ngrad;
+    int dir[2];
+} Field;
+
+static Field Fields[] = {
+    {PACK_DENSITY, "density", 0, 0, {0, 0}},
+    {PACK_POTENTIAL, "potential", 1, 0, {0, 0}},
+    {PACK_ACC_X, "acc_x", 1, 1, {0, 0}},
+    {PACK_ACC_Y, "acc_y", 1, 1, {1, 0}},
+    {PACK_ACC_Z, "acc_z", 1, 1, {2, 0}},
+    {PACK_TIDAL_XX, "tidal_xx", 1, 2, {0, 0}},
+    {PACK_TIDAL_XY, "tidal_xy", 1, 2, {0, 1}},
+    {PACK_TIDAL_ZX, "tidal_zx", 1, 2, {2, 0}},
+};
+
+static double
+sinc(double x)
+{
+    if(fabs(x) < 1e-5) return 1.0 - x * x / 6.;
+    return sin(x) / x;
+}
+
+/* the transfer function of a central difference along an axis; w = k h */
+static double
+diff(int order, double k, double h)
+{
+    double w = k * h;
+    switch(order) {
+        case 0:
+            return k;
+        case 1:
+            return (8 * sin(w) - sin(2 * w)) / (6 * h);
+        case 2:
+            return (45 * sin(w) - 9 * sin(2 * w) + sin(3 * w)) / (30 * h);
+    }
+    return 0;
+}
+
+static double
+laplace(int order, double k, double h)
+{
+    double ff1 = sinc(0.5 * k * h);
+    double ff2 = sinc(k * h);
+    switch(order) {
+        case 0:
+            return k * k;
+        case 1:
+            return k * k * ff1 * ff1;
+        case 2:
+            return k * k * (4 / 3.0 * ff1 * ff1 - 1 / 3.0 * ff2 * ff2);
+    }
+    return 0;
+}
+
+/* the field of the plane wave of the kernel is amp * cos(theta), or amp * sin(theta) if *odd. */
+static double
+plane_wave_amplitude(Kernel * kernel, Field * field, double k[3], double h, int * odd)
+{
+    double fac = 1;
+    int d, n;
+    for(d = 0; d < 3; d ++) {
+        for(n = 0; n < kernel->ndecic && field->attribute != PACK_DENSITY; n ++) {
+            fac /= pow(sinc(0.5 * k[d] * h), 2);
+        }
+    }
+    if(field->potential) {
+        double kk = 0;
+        for(d = 0; d < 3; d ++) {
+            kk += laplace(kernel->potorder, k[d], h);
+        }
+        fac *= -1 / kk;
+    }
+    for(n = 0; n < field->ngrad; n ++) {
+        fac *= diff(kernel->gradorder, k[field->dir[n]], h);
+    }
+    /* i k of cos is - k sin; - k k of cos is - k k cos. */
+    *odd = field->ngrad == 1;
+    return field->ngrad > 0 ? -fac : fac;
+}
+
+static void
+fill_plane_wave(PM * pm, FastPMFloat * real, double k[3])
+{
+    ptrdiff_t i, j, l;
+    for(i = 0; i < pm->IRegion.size[0]; i ++)
+    for(j = 0; j < pm->IRegion.size[1]; j ++)
+    for(l = 0; l < pm->IRegion.size[2]; l ++) {
+        double theta = Phase
+            + k[0] * (pm->IRegion.start[0] + i) * pm->CellSize[0]
+            + k[1] * (pm->IRegion.start[1] + j) * pm->CellSize[1]
+            + k[2] * (pm->IRegion.start[2] + l) * pm->CellSize[2];
+        real[i * pm->IRegion.strides[0] + j * pm->IRegion.strides[1] + l * pm->IRegion.strides[2]] = cos(theta);
+    }
+}
+
+/* the largest difference of real from amp * cos(theta) (or sin), over all ranks, relative to amp */
+static double
+plane_wave_error(PM * pm, FastPMFloat * real, double k[3], double amp, int odd)
+{
+    double err = 0;
+    ptrdiff_t i, j, l;
+    for(i = 0; i < pm->IRegion.size[0]; i ++)
+    for(j = 0; j < pm->IRegion.size[1]; j ++)
+    for(l = 0; l < pm->IRegion.size[2]; l ++) {
+        double theta = Phase
+            + k[0] * (pm->IRegion.start[0] + i) * pm->CellSize[0]
+            + k[1] * (pm->IRegion.start[1] + j) * pm->CellSize[1]
+            + k[2] * (pm->IRegion.start[2] + l) * pm->CellSize[2];
+        double expected = amp * (odd ? sin(theta) : cos(theta));
+        double e = fabs(real[i * pm->IRegion.strides[0] + j * pm->IRegion.strides[1] + l * pm->IRegion.strides[2]] - expected);
+        if(e > err) err = e;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_DOUBLE, MPI_MAX, pm_comm(pm));
+    return err / fabs(amp);
+}
+
+/* the largest difference of two local meshes, over all ranks */
+static double
+mesh_difference(PM * pm, FastPMFloat * a, FastPMFloat * b)
+{
+    double err = 0;
+    ptrdiff_t i, j, l;
+    for(i = 0; i < pm->IRegion.size[0]; i ++)
+    for(j = 0; j < pm->IRegion.size[1]; j ++)
+    for(l = 0; l < pm->IRegion.size[2]; l ++) {
+        ptrdiff_t ind = i * pm->IRegion.strides[0] + j * pm->IRegion.strides[1] + l * pm->IRegion.strides[2];
+        double e = fabs(a[ind] - b[ind]);
+        if(e > err) err = e;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_DOUBLE, MPI_MAX, pm_comm(pm));
+    return err;
+}
+
+static void
+test_kernels(PM * pm, double tol)
+{
+    FastPMFloat * real = pm_alloc(pm);
+    FastPMFloat * delta_k = pm_alloc(pm);
+    FastPMFloat * canvas = pm_alloc(pm);
+    FastPMFloat * fd = pm_alloc(pm);
+
+    PMHalo halo[1];
+    pm_halo_init(halo, pm, 3);
+    FastPMFloat * extended = pm_alloc(&halo->pm);
+
+    int m, t, f;
+    for(m = 0; m < sizeof(Modes) / sizeof(Modes[0]); m ++) {
+        double k[3];
+        int d;
+        for(d = 0; d < 3; d ++) {
+            k[d] = Modes[m][d] * 2 * M_PI / pm->BoxSize[d];
+        }
+        fill_plane_wave(pm, real, k);
+        pm_r2c(pm, real, delta_k);
+
+        for(t = 0; t < sizeof(Kernels) / sizeof(Kernels[0]); t ++) {
+            Kernel * kernel = &Kernels[t];
+            FastPMGravity gravity = {
+                .KernelType = kernel->type,
+                .DealiasingType = FASTPM_DEALIASING_NONE,
+            };
+            for(f = 0; f < sizeof(Fields) / sizeof(Fields[0]); f ++) {
+                Field * field = &Fields[f];
+                int odd;
+                double amp = plane_wave_amplitude(kernel, field, k, pm->CellSize[0], &odd);
+                /* no signal along the axis */
+                if(fabs(amp) < 1e-3) continue;
+
+                gravity_apply_kernel_transfer(&gravity, pm, delta_k, canvas, field->attribute);
+                pm_c2r(pm, canvas);
+
+                double err = plane_wave_error(pm, canvas, k, amp, odd);
+                if(err > tol) {
+                    fastpm_raise(-1, "kernel %s field %s mode (%d %d %d): error %g\n",
+                        kernel->name, field->name, Modes[m][0], Modes[m][1], Modes[m][2], err);
+                }
+
+                /* the central differences in real space */
+                int npoints = kernel->type == FASTPM_KERNEL_3_4_FD ? 4 :
+                              kernel->type == FASTPM_KERNEL_3_6_FD ? 6 : 0;
+                if(npoints == 0 || field->ngrad != 1) continue;
+
+                gravity_apply_kernel_transfer(&gravity, pm, delta_k, fd, PACK_POTENTIAL);
+                pm_c2r(pm, fd);
+                pm_halo_fill(halo, fd, extended);
+                pm_halo_gradient(halo, extended, fd, field->dir[0], npoints);
+
+                double diff = mesh_difference(pm, fd, canvas) / fabs(amp);
+                if(diff > tol) {
+                    fastpm_raise(-1, "kernel %s field %s mode (%d %d %d): the real space gradient differs by %g\n",
+                        kernel->name, field->name, Modes[m][0], Modes[m][1], Modes[m][2], diff);
+                }
+            }
+        }
+    }
+
+    pm_free(&halo->pm, extended);
+    pm_halo_destroy(halo);
+    pm_free(pm, fd);
+    pm_free(pm, canvas);
+    pm_free(pm, delta_k);
+    pm_free(pm, real);
+}
+
+int main(int argc, char * argv[]) {
+
+    MPI_Init(&argc, &argv);
+
+    libfastpm_init();
+
+    MPI_Comm comm = MPI_COMM_WORLD;
+
+    fastpm_set_msg_handler(fastpm_default_msg_handler, comm, NULL);
+
+    int NTask;
+    MPI_Comm_size(comm, &NTask);
+
+    /* the tables of the kernels are in single precision */
+    double tol = sizeof(FastPMFloat) == 8 ? 1e-5 : 1e-4;
+
+    /* every process mesh, such that each axis is decomposed or periodic on a rank */
+    int NprocY;
+    for(NprocY = 1; NprocY <= NTask; NprocY ++) {
+        if(NTask % NprocY != 0) continue;
+
+        PMInit pminit = {
+            .Nmesh = 24,
+            .BoxSize = 48.,
+            .NprocY = NprocY,
+            .transposed = 1,
+            .use_fftw = 0,
+        };
+        PM pm[1];
+        pm_init(pm, &pminit, comm);
+
+        test_kernels(pm, tol);
+
+        fastpm_info("kernels agree on the process mesh %d x %d.\n", pm->Nproc[0], pm->Nproc[1]);
+
+        pm_destroy(pm);
+    }
+
+    libfastpm_cleanup();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <mpi.h>
+
+#include <fastpm/libfastpm.h>
+#include <fastpm/logging.h>
+
+#include "permute.h"
+
+/* columns of different item sizes; the value of item i of every column encodes i */
+struct Item3 { unsigned char v[3]; };
+struct Item40 { double v[5]; };
+
+static void
+fill(int * a, double * b, struct Item3 * c, struct Item40 * d, ptrdiff_t np)
+{
+    ptrdiff_t i;
+    for(i = 0; i < np; i ++) {
+        a[i] = i;
+        b[i] = i * 0.5;
+        c[i].v[0] = i & 0xff;
+        c[i].v[1] = (i >> 8) & 0xff;
+        c[i].v[2] = (i >> 16) & 0xff;
+        int k;
+        for(k = 0; k < 5; k ++) {
+            d[i].v[k] = i * 5 + k;
+        }
+    }
+}
+
+static void
+check(int * a, double * b, struct Item3 * c, struct Item40 * d, ptrdiff_t np, int * ind)
+{
+    ptrdiff_t i;
+    for(i = 0; i < np; i ++) {
+        ptrdiff_t j = ind[i];
+        int ok = a[i] == j && b[i] == j * 0.5
+            && c[i].v[0] == (j & 0xff)
+            && c[i].v[1] == ((j >> 8) & 0xff)
+            && c[i].v[2] == ((j >> 16) & 0xff);
+        int k;
+        for(k = 0; k < 5; k ++) {
+            ok = ok && d[i].v[k] == j * 5 + k;
+        }
+        if(!ok) {
+            fastpm_raise(-1, "item %td of %td is not the item %td.\n", i, np, j);
+        }
+    }
+}
+
+static void
+test_permute(int * ind, ptrdiff_t np, FastPMMemory * mem)
+{
+    int * a = malloc(sizeof(a[0]) * np);
+    double * b = malloc(sizeof(b[0]) * np);
+    struct Item3 * c = malloc(sizeof(c[0]) * np);
+    struct Item40 * d = malloc(sizeof(d[0]) * np);
+
+    void * data[] = {a, b, c, d};
+    size_t elsize[] = {sizeof(a[0]), sizeof(b[0]), sizeof(c[0]), sizeof(d[0])};
+
+    fill(a, b, c, d, np);
+    fastpm_permute(data, elsize, 4, np, ind, mem);
+    check(a, b, c, d, np, ind);
+
+    free(d);
+    free(c);
+    free(b);
+    free(a);
+}
+
+/* the next permutation in lexical order; 0 after the last */
+static int
+next_permutation(int * ind, int n)
+{
+    int i = n - 2;
+    while(i >= 0 && ind[i] > ind[i + 1]) i --;
+    if(i < 0) return 0;
+    int j = n - 1;
+    while(ind[j] < ind[i]) j --;
+    int t = ind[i]; ind[i] = ind[j]; ind[j] = t;
+    for(i = i + 1, j = n - 1; i < j; i ++, j --) {
+        t = ind[i]; ind[i] = ind[j]; ind[j] = t;
+    }
+    return 1;
+}
+
+static jmp_buf rejected;
+
+static void
+reject_handler(
+        const enum FastPMLogLevel level,
+        const enum FastPMLogType type,
+        const int errcode,
+        const char * message,
+        MPI_Comm comm,
+        void * userdata)
+{
+    if(level == ERROR) longjmp(rejected, 1);
+}
+
+/* 1 if fastpm_permute raises on ind. The scratch of mem is not freed after a raise,
+ * so mem is not used again. */
+static int
+raises(int * ind, ptrdiff_t np)
+{
+    FastPMMemory mem[1] = {{.alignment = 0}};
+    fastpm_memory_init(mem, 0, 0);
+
+    int data[np];
+    void * columns[] = {data};
+    size_t elsize[] = {sizeof(data[0])};
+
+    fastpm_push_msg_handler(reject_handler, MPI_COMM_SELF, NULL);
+    if(setjmp(rejected)) {
+        fastpm_pop_msg_handler();
+        return 1;
+    }
+    fastpm_permute(columns, elsize, 1, np, ind, mem);
+    fastpm_pop_msg_handler();
+    fastpm_memory_destroy(mem);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+
+    MPI_Init(&argc, &argv);
+
+    libfastpm_init();
+
+    MPI_Comm comm = MPI_COMM_WORLD;
+
+    fastpm_set_msg_handler(fastpm_default_msg_handler, comm, NULL);
+
+    FastPMMemory * mem = _libfastpm_get_gmem();
+
+    /* every permutation of up to 7 items */
+    int n;
+    for(n = 1; n <= 7; n ++) {
+        int ind[n];
+        int i;
+        for(i = 0; i < n; i ++) ind[i] = i;
+        int count = 0;
+        do {
+            test_permute(ind, n, mem);
+            count ++;
+        } while(next_permutation(ind, n));
+        fastpm_info("checked %d permutations of %d items.\n", count, n);
+    }
+
+    /* a long random permutation with long rings */
+    ptrdiff_t np = 100003;
+    int * ind = malloc(sizeof(ind[0]) * np);
+    ptrdiff_t i;
+    for(i = 0; i < np; i ++) ind[i] = i;
+    srand(2004);
+    for(i = np - 1; i > 0; i --) {
+        ptrdiff_t j = rand() % (i + 1);
+        int t = ind[i]; ind[i] = ind[j]; ind[j] = t;
+    }
+    test_permute(ind, np, mem);
+    free(ind);
+    fastpm_info("checked a random permutation of %td items.\n", np);
+
+    /* not permutations */
+    int repeated[] = {0, 0, 1};
+    int cycle_and_repeat[] = {1, 2, 1, 3};
+    int too_large[] = {1, 3, 0};
+    int negative[] = {2, -1, 0};
+    if(!raises(repeated, 3)
+    || !raises(cycle_and_repeat, 4)
+    || !raises(too_large, 3)
+    || !raises(negative, 3)) {
+        fastpm_raise(-1, "a non-permutation is not rejected.\n");
+    }
+    fastpm_info("non-permutations are rejected.\n");
+
+    libfastpm_cleanup();
+    MPI_Finalize();
+    return 0;
+}